@@ -1,6 +1,7 @@
 #ifndef _ASYNC_I2C_H
 #define _ASYNC_I2C_H
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -12,6 +13,60 @@
 #define PARAM_ASSERTIONS_ENABLED_ASYNC_I2C_TARGET 0
 #endif
 
+// PICO_CONFIG: ASYNC_I2C_TARGET_NUM_SLOTS, Number of received commands which can be queued waiting to be processed or have their response read, type=int, default=4, min=1, group=Actuator
+#ifndef ASYNC_I2C_TARGET_NUM_SLOTS
+#define ASYNC_I2C_TARGET_NUM_SLOTS 4
+#endif
+
+// The depth of the i2c hardware receive fifo, which limits how many bytes can be waited for before interrupting
+#define ASYNC_I2C_TARGET_RX_FIFO_DEPTH 16
+
+// PICO_CONFIG: ASYNC_I2C_TARGET_RX_MAX_THRESHOLD, Most received bytes to wait for before interrupting. Kept below the fifo depth so long commands leave time to drain the fifo before it fills, type=int, default=8, min=1, max=16, group=Actuator
+#ifndef ASYNC_I2C_TARGET_RX_MAX_THRESHOLD
+#define ASYNC_I2C_TARGET_RX_MAX_THRESHOLD 8
+#endif
+static_assert(ASYNC_I2C_TARGET_RX_MAX_THRESHOLD <= ASYNC_I2C_TARGET_RX_FIFO_DEPTH, "The rx threshold must fit in the fifo");
+
+/**
+ * @brief Protocol errors detected by the target
+ * These are found in the interrupt, where logging is too slow for the bus, so they are counted and read with async_i2c_target_get_stats
+ */
+enum async_i2c_target_error {
+    ASYNC_I2C_TARGET_ERROR_INVALID_CRC = 0,         // Command crc did not match. Data is the received crc
+    ASYNC_I2C_TARGET_ERROR_TRANSMIT_ABORTED = 1,    // Sending a response was aborted. Data is the tx_abrt_source register
+    ASYNC_I2C_TARGET_ERROR_RESPONSE_TERMINATED = 2, // The controller stopped reading before the end of the response. Data is the bytes queued
+    ASYNC_I2C_TARGET_ERROR_UNEXPECTED_RX_DONE = 3,  // A read finished with no response active
+    ASYNC_I2C_TARGET_ERROR_RESPONSE_DROPPED = 4,    // A new command was received before the response was read
+    ASYNC_I2C_TARGET_ERROR_COMMAND_DROPPED = 5,     // A new command was received before the previous command finished
+    ASYNC_I2C_TARGET_ERROR_QUEUE_FULL = 6,          // A new command was received with every slot in use
+    ASYNC_I2C_TARGET_ERROR_INVALID_COMMAND = 7,     // Unknown command id. Data is the command id
+    ASYNC_I2C_TARGET_ERROR_BATCH_TOO_LONG = 8,      // Batch payload longer than ACTUATOR_BATCH_MAX_PAYLOAD. Data is the payload length
+    ASYNC_I2C_TARGET_ERROR_UNEXPECTED_BYTES = 9,    // Bytes received outside of a command. Data is the number of bytes dropped
+    ASYNC_I2C_TARGET_ERROR_COMMAND_TERMINATED = 10, // The frame stopped before the whole command was received. Data is the bytes received
+    ASYNC_I2C_TARGET_ERROR_UNEXPECTED_READ = 11,    // A read with no commands queued
+    ASYNC_I2C_TARGET_ERROR_TOO_MANY_BYTES_READ = 12,// A read past the end of the response
+    ASYNC_I2C_TARGET_ERROR_NO_RESPONSE = 13,        // A read of a command which finished without a response
+
+    ASYNC_I2C_TARGET_NUM_ERRORS
+};
+
+/**
+ * @brief Interrupt and error counters for the target
+ * Interrupts per command can be found from the change in interrupts over the change in commands_received
+ */
+struct async_i2c_target_stats {
+    uint32_t interrupts;            // Total number of interrupts serviced
+    uint32_t rx_full_interrupts;    // Interrupts raised by the rx threshold
+    uint32_t stop_det_interrupts;   // Interrupts raised by a stop on a transfer addressed to the target
+    uint32_t rd_req_interrupts;     // Interrupts raised by the controller reading a response
+    uint32_t tx_empty_interrupts;   // Interrupts raised to refill the tx fifo
+    uint32_t commands_received;     // Commands received with a valid crc
+    uint32_t error_counts[ASYNC_I2C_TARGET_NUM_ERRORS];
+    uint32_t total_errors;          // Sum of error_counts
+    enum async_i2c_target_error last_error;
+    uint32_t last_error_data;       // Detail for last_error, see enum async_i2c_target_error
+};
+
 // I2C Request Types
 struct async_i2c_request;
 
@@ -43,6 +98,7 @@ extern bool async_i2c_target_initialized;
  * @brief Attempts to get the next command from the I2C bus.
  * If there is a command received it is written into command.
  * If no command is received then it will return false.
+ * Commands are returned in the order received, and the previous command must be finished before the next is read.
  * 
  * @param cmd The output for the received command
  * @return true Succesfully received a command into cmd
@@ -53,6 +109,7 @@ bool async_i2c_target_get_next_command(actuator_i2c_cmd_t *cmd);
 /**
  * @brief Finishes the active command and reponds with the given response.
  * If response is NULL then there will be no response sent with the command.
+ * The response is copied, and is sent on the controller's next read once the responses of any earlier commands have been read.
  *
  * This function handles crc8 calculation for the response
  * 
@@ -61,6 +118,27 @@ bool async_i2c_target_get_next_command(actuator_i2c_cmd_t *cmd);
  */
 void async_i2c_target_finish_command(actuator_i2c_response_t *response, size_t size);
 
+/**
+ * @brief Sets the status response sent for GET_STATUS commands.
+ * Once set, GET_STATUS is answered directly from the interrupt with the latest status instead of being returned by async_i2c_target_get_next_command.
+ * The response is copied, so it only needs to be called when the status changes.
+ *
+ * This function handles crc8 calculation for the response
+ *
+ * @param response The status response
+ * @param size The size of the response
+ */
+void async_i2c_target_set_status(actuator_i2c_response_t *response, size_t size);
+
+/**
+ * @brief Copies the interrupt and error counters of the target
+ *
+ * INTERRUPT SAFE
+ *
+ * @param stats Output for the counters
+ */
+void async_i2c_target_get_stats(struct async_i2c_target_stats *stats);
+
 /**
  * @brief Initialize async i2c and the corresponding i2c hardware in target mode
  * 
@@ -31,49 +31,152 @@ const uint scl_pin = CONNECTOR_SCL_PIN;
 // Bus Management Functions
 // ========================================
 
-static struct active_transfer_data {
-    /* Request States
-     * I2C_TARGET_IDLE: The target is idle and processing any active requests on the bus
-     * I2C_TARGET_RECEIVING: The target is in the process of receiving a command on the bus
-     * I2C_TARGET_CMD_RECEIVED: The command has been succesfully received and is waiting to be read by other code
-     * I2C_TARGET_CMD_PROCESSING: The command has been read by code and is waiting for a response to be posted
-     * I2C_TARGET_WAITING_FOR_RESPONSE: A response has been requested by the i2c controller but has no data. The callback must then start the response
-     * I2C_TARGET_RESPONDING: A response has been posted and is current waiting to be read by the i2c controller
+static struct command_slot {
+    /* Slot States
+     * SLOT_FREE: The slot is not holding a command
+     * SLOT_RECEIVING: A command is being received into the slot on the bus. Only the slot at recv_index can be receiving
+     * SLOT_RECEIVED: The command has been succesfully received and is waiting to be read by other code
+     * SLOT_PROCESSING: The command has been read by code and is waiting for a response to be posted
+     * SLOT_RESPONSE_READY: A response has been posted and is waiting to be read by the i2c controller
+     * SLOT_RESPONDING: The response is currently being read by the i2c controller
      */
-    enum {I2C_TARGET_IDLE, I2C_TARGET_RECEIVING, I2C_TARGET_CMD_RECEIVED, I2C_TARGET_CMD_PROCESSING, I2C_TARGET_WAITING_FOR_RESPONSE, I2C_TARGET_RESPONDING} state;
+    enum {SLOT_FREE, SLOT_RECEIVING, SLOT_RECEIVED, SLOT_PROCESSING, SLOT_RESPONSE_READY, SLOT_RESPONDING} state;
 
-    // Field valid when in mode I2C_TARGET_RECEIVING and I2C_TARGET_CMD_RECEIVED
+    // Field valid when in state SLOT_RECEIVING through SLOT_PROCESSING
     actuator_i2c_cmd_t received_command;
     uint16_t bytes_received;
     uint16_t recv_size;
 
-    // Field valid when in mode I2C_TARGET_RESPONDING
-    actuator_i2c_response_t *response;
+    // Field valid when in state SLOT_RESPONSE_READY and SLOT_RESPONDING
+    actuator_i2c_response_t response;
     uint16_t response_size;
     uint16_t bytes_sent;
-} active_transfer = {.state = I2C_TARGET_IDLE};
+} command_slots[ASYNC_I2C_TARGET_NUM_SLOTS] = {0};
+
+// Commands are processed and responded to in the order they are received
+// This allows the controller to write several commands before collecting their responses
+static struct command_ring {
+    uint recv_index;            // The slot the next command is received into
+    uint process_index;         // The next slot to be returned by async_i2c_target_get_next_command
+    uint respond_index;         // The oldest queued slot, which is responded to on the next read
+    uint num_queued;            // The number of slots from respond_index which hold a received command
+    uint num_unprocessed;       // The number of slots from process_index which have been received, including those already answered by the irq
+    bool waiting_for_response;  // A response was requested by the controller before the slot at respond_index had one. Finishing the command must start the response
+    bool command_processing;    // A command has been returned by async_i2c_target_get_next_command and is yet to be finished
+    uint processing_index;      // The slot being processed, valid if command_processing is set
+} command_ring = {0};
+
+// The status response is pre-built by the main loop so GET_STATUS can be answered from the irq without stretching the clock
+// The main loop writes the inactive frame then swaps, so the irq always copies a complete frame
+static struct status_cache {
+    actuator_i2c_response_t frames[2];
+    uint16_t frame_sizes[2];
+    uint active_frame;
+    bool valid;
+} status_cache = {0};
+
+static struct async_i2c_target_stats target_stats = {0};
+
+static inline uint async_i2c_next_slot(uint index) {
+    return (index + 1) % ASYNC_I2C_TARGET_NUM_SLOTS;
+}
 
 #define has_irq_pending(i2c_inst, irq_name) (i2c_inst->hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_##irq_name##_BITS)
 
 /**
- * @brief Fills the transmit queue of the i2c with data in the active_transfer
+ * @brief Returns the slot which is currently being read by the controller, or NULL if no response is being sent
+ */
+static inline struct command_slot *async_i2c_responding_slot(void) {
+    struct command_slot *slot = &command_slots[command_ring.respond_index];
+    return (command_ring.num_queued > 0 && slot->state == SLOT_RESPONDING ? slot : NULL);
+}
+
+/**
+ * @brief Fills the transmit queue of the i2c with data from the responding slot
  */
 static void async_i2c_fill_transmit_queue(void) {
     LOG_DEBUG("Filling up I2C queue");
 
-    uint8_t *raw_response = (uint8_t*)active_transfer.response;
-    while (i2c_get_write_available(i2c_inst) && active_transfer.bytes_sent < active_transfer.response_size){
-        i2c_get_hw(i2c_inst)->data_cmd = raw_response[active_transfer.bytes_sent];
-        active_transfer.bytes_sent++;
+    struct command_slot *slot = &command_slots[command_ring.respond_index];
+    uint8_t *raw_response = (uint8_t*)(&slot->response);
+    while (i2c_get_write_available(i2c_inst) && slot->bytes_sent < slot->response_size){
+        i2c_get_hw(i2c_inst)->data_cmd = raw_response[slot->bytes_sent];
+        slot->bytes_sent++;
     }
 
-    if (active_transfer.bytes_sent == active_transfer.response_size) {
+    if (slot->bytes_sent == slot->response_size) {
         hw_clear_bits(&i2c_inst->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
     } else {
         hw_set_bits(&i2c_inst->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
     }
 }
 
+/**
+ * @brief Starts sending the response in the slot at respond_index, which must be in state SLOT_RESPONSE_READY
+ * Must be called from the irq or with interrupts disabled
+ */
+static void async_i2c_start_response(void) {
+    struct command_slot *slot = &command_slots[command_ring.respond_index];
+    slot->state = SLOT_RESPONDING;
+    slot->bytes_sent = 0;
+    command_ring.waiting_for_response = false;
+    async_i2c_fill_transmit_queue();
+}
+
+/**
+ * @brief Removes finished slots from the front of the queue so respond_index points to the oldest command still needing a response
+ * Must be called from the irq or with interrupts disabled
+ */
+static void async_i2c_release_finished_slots(void) {
+    while (command_ring.num_queued > 0 && command_slots[command_ring.respond_index].state == SLOT_FREE) {
+        command_ring.respond_index = async_i2c_next_slot(command_ring.respond_index);
+        command_ring.num_queued--;
+    }
+}
+
+/**
+ * @brief Responds to the command in slot from the status cache if it is a GET_STATUS command
+ * Must be called from the irq
+ *
+ * @param slot The slot with the newly received command
+ * @return true The response was filled from the cache and the command does not need processing
+ * @return false The command must be processed by the main loop
+ */
+static bool async_i2c_serve_cached_status(struct command_slot *slot) {
+    if (!status_cache.valid || slot->received_command.cmd_id != ACTUATOR_CMD_GET_STATUS) {
+        return false;
+    }
+
+    uint frame = status_cache.active_frame;
+    memcpy(&slot->response, &status_cache.frames[frame], status_cache.frame_sizes[frame]);
+    slot->response_size = status_cache.frame_sizes[frame];
+    slot->bytes_sent = 0;
+    slot->state = SLOT_RESPONSE_READY;
+
+    return true;
+}
+
+/**
+ * @brief Sets the rx fifo threshold so the next interrupt fires once the rest of the current command has arrived
+ * While idle this is the smallest possible command, and for variable length commands this is the length needed to find their size.
+ * Commands longer than ASYNC_I2C_TARGET_RX_MAX_THRESHOLD are received over several interrupts.
+ * Bytes received below the threshold at the end of a frame are drained on STOP_DET or RD_REQ
+ *
+ * @param i2c The i2c hardware to configure
+ */
+static void async_i2c_update_rx_threshold(i2c_inst_t *i2c) {
+    struct command_slot *slot = &command_slots[command_ring.recv_index];
+    uint bytes_needed = ACTUATOR_BASE_CMD_LENGTH;
+    if (slot->state == SLOT_RECEIVING && slot->recv_size > slot->bytes_received) {
+        bytes_needed = slot->recv_size - slot->bytes_received;
+    }
+    if (bytes_needed > ASYNC_I2C_TARGET_RX_MAX_THRESHOLD) {
+        bytes_needed = ASYNC_I2C_TARGET_RX_MAX_THRESHOLD;
+    }
+
+    i2c->hw->rx_tl = bytes_needed - 1;
+}
+
 static void async_i2c_restart_hardware(i2c_inst_t *i2c) {
     if (i2c->hw->status & I2C_IC_STATUS_SLV_ACTIVITY_BITS) {
         LOG_ERROR("Cannot restart hw with active read request");
@@ -91,12 +194,56 @@ static void async_i2c_restart_hardware(i2c_inst_t *i2c) {
     do {tight_loop_contents();} while(!(i2c->hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS));
 }
 
+/**
+ * @brief Drops the command currently being received and restarts the hardware
+ * Commands which have already been queued are kept
+ */
 static void async_i2c_target_abort(i2c_inst_t *i2c) {
-    active_transfer.state = I2C_TARGET_IDLE;
+    if (command_slots[command_ring.recv_index].state == SLOT_RECEIVING) {
+        command_slots[command_ring.recv_index].state = SLOT_FREE;
+    }
+    async_i2c_update_rx_threshold(i2c);
     async_i2c_restart_hardware(i2c);
 }
 
-#define I2C_PROTOCOL_ERR(...) LOG_WARN(__VA_ARGS__); safety_raise_fault(FAULT_I2C_PROTO_ERROR);
+/**
+ * @brief Records a protocol error and raises the fault
+ * Logging from the interrupt is too slow for the bus, so errors are counted and can be logged from the main loop
+ *
+ * @param error The error which occurred
+ * @param data Error specific detail, see enum async_i2c_target_error
+ */
+static void async_i2c_target_record_error(enum async_i2c_target_error error, uint32_t data) {
+    target_stats.error_counts[error]++;
+    target_stats.total_errors++;
+    target_stats.last_error = error;
+    target_stats.last_error_data = data;
+    safety_raise_fault(FAULT_I2C_PROTO_ERROR);
+}
+
+/**
+ * @brief Checks the crc of a fully received command and queues it
+ * Must be called from the irq
+ *
+ * @param i2c The i2c hardware the command was received on
+ * @param slot The slot at recv_index which has received all of its bytes
+ */
+static void async_i2c_complete_command(i2c_inst_t *i2c, struct command_slot *slot) {
+    uint8_t calculated_crc = actuator_i2c_crc8_calc_command(&slot->received_command, slot->bytes_received);
+    if (calculated_crc == slot->received_command.crc8) {
+        LOG_DEBUG("Command received");
+        target_stats.commands_received++;
+        if (!async_i2c_serve_cached_status(slot)) {
+            slot->state = SLOT_RECEIVED;
+        }
+        command_ring.recv_index = async_i2c_next_slot(command_ring.recv_index);
+        command_ring.num_queued++;
+        command_ring.num_unprocessed++;
+    } else {
+        async_i2c_target_abort(i2c);
+        async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_INVALID_CRC, slot->received_command.crc8);
+    }
+}
 
 /**
  * @brief Common irq handler for i2c related tasks
@@ -104,7 +251,8 @@ static void async_i2c_target_abort(i2c_inst_t *i2c) {
  * @param i2c The i2c inst which caused the interrupt
  */
 static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
-    LOG_DEBUG("Interrupt callback on %s state %d, active interrupts 0x%x", (i2c == i2c0 ? "i2c0" : (i2c == i2c1 ? "i2c1" : "Unknown")), active_transfer.state, i2c->hw->raw_intr_stat & i2c->hw->intr_mask);
+    target_stats.interrupts++;
+    LOG_DEBUG("Interrupt callback on %s, %d commands queued, active interrupts 0x%x", (i2c == i2c0 ? "i2c0" : (i2c == i2c1 ? "i2c1" : "Unknown")), command_ring.num_queued, i2c->hw->raw_intr_stat & i2c->hw->intr_mask);
 
     // Handle software issues first
     if (has_irq_pending(i2c, TX_OVER)) {
@@ -123,43 +271,45 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
 
     if (has_irq_pending(i2c, TX_ABRT)) {
         LOG_DEBUG("TX_ABRT INT");
-        if (active_transfer.state != I2C_TARGET_RESPONDING){
-            LOG_ERROR("TX Abort interrupt in invalid state %d", active_transfer.state);
+        struct command_slot *responding_slot = async_i2c_responding_slot();
+        if (!responding_slot){
+            LOG_ERROR("TX Abort interrupt with no response active");
             safety_raise_fault(FAULT_I2C_ERROR);
         }
 
         // Transmit abort
-        __unused uint32_t abort_reason = i2c->hw->tx_abrt_source;
+        uint32_t abort_reason = i2c->hw->tx_abrt_source;
         i2c->hw->clr_tx_abrt;
 
-        I2C_PROTOCOL_ERR("Transmit aborted: %d bytes lost, reason: 0x%x",
-                    (abort_reason>>I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_LSB) + (active_transfer.response_size-active_transfer.bytes_sent),
-                    abort_reason&(~I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS));
+        async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_TRANSMIT_ABORTED, abort_reason);
     }
 
     // Handle normal states
     if (has_irq_pending(i2c, RX_DONE)) {
-        // Transmit done, clean up active transfer
+        // Transmit done, clean up the responding slot
         LOG_DEBUG("RX_DONE INT");
         i2c->hw->clr_rx_done;
 
-        if (active_transfer.state == I2C_TARGET_RESPONDING) {
-            if (active_transfer.bytes_sent != active_transfer.response_size && i2c_get_hw(i2c)->txflr != 0) {
-                I2C_PROTOCOL_ERR("Response terminated early, %d/%d bytes queued, %d in buffer", active_transfer.bytes_sent, active_transfer.response_size, i2c_get_hw(i2c)->txflr);
+        struct command_slot *responding_slot = async_i2c_responding_slot();
+        if (responding_slot) {
+            if (responding_slot->bytes_sent != responding_slot->response_size && i2c_get_hw(i2c)->txflr != 0) {
+                async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_RESPONSE_TERMINATED, responding_slot->bytes_sent);
             }
 
-            active_transfer.state = I2C_TARGET_IDLE;
+            responding_slot->state = SLOT_FREE;
+            async_i2c_release_finished_slots();
             hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
         } else {
-            I2C_PROTOCOL_ERR("Unexpected rx done in invalid state %d", active_transfer.state);
+            async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_UNEXPECTED_RX_DONE, 0);
         }
     }
 
     if (has_irq_pending(i2c, TX_EMPTY) && (i2c_get_hw(i2c)->intr_mask & I2C_IC_INTR_MASK_M_TX_EMPTY_BITS)) {
         // Transmit buffer needs to be filled (cleared by hw)
+        target_stats.tx_empty_interrupts++;
 
-        if (active_transfer.state != I2C_TARGET_RESPONDING) {
-            LOG_ERROR("TX Empty interrupt in invalid state %d", active_transfer.state);
+        if (!async_i2c_responding_slot()) {
+            LOG_ERROR("TX Empty interrupt with no response active");
             safety_raise_fault(FAULT_I2C_ERROR);
             hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
         } else {
@@ -167,91 +317,133 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
         }
     }
 
-    if (has_irq_pending(i2c, RD_REQ)) {
-        // Read requested from device
-        LOG_DEBUG("RD_REQ INT");
-        i2c->hw->clr_rd_req;
-
-        if (active_transfer.state == I2C_TARGET_CMD_PROCESSING || active_transfer.state == I2C_TARGET_CMD_RECEIVED) {
-            // Mark as waiting for response so when one is provided it gets immediately sent
-            active_transfer.state = I2C_TARGET_WAITING_FOR_RESPONSE;
-        } else if (active_transfer.state == I2C_TARGET_RESPONDING) {
-            if (active_transfer.bytes_sent < active_transfer.response_size) {
-                async_i2c_fill_transmit_queue();
-            } else {
-                i2c->hw->data_cmd = 0xFF;
-                I2C_PROTOCOL_ERR("Too many bytes read");
-            }
-        } else {
-            i2c->hw->data_cmd = 0xFF;
-            I2C_PROTOCOL_ERR("Unexpected read request");
-        }
-    }
-
-    if (has_irq_pending(i2c, RX_FULL)) {
+    // Received data is handled before read requests, so a command written immediately before a read is queued before the read is served
+    // The rx threshold waits for the rest of the command, so any bytes below the threshold are drained at the end of the frame
+    bool frame_ended = has_irq_pending(i2c, STOP_DET) || has_irq_pending(i2c, RD_REQ);
+    if (has_irq_pending(i2c, RX_FULL) || (frame_ended && i2c_get_read_available(i2c))) {
         // Data in receive buffer (cleared by hw)
         LOG_DEBUG("RX_FULL INT");
+        if (has_irq_pending(i2c, RX_FULL)) {
+            target_stats.rx_full_interrupts++;
+        }
 
-        if (active_transfer.state == I2C_TARGET_IDLE || active_transfer.state == I2C_TARGET_RECEIVING) {
-            uint8_t *raw_recv_buffer = (uint8_t*)(&active_transfer.received_command);
-            __unused size_t max_recv_buffer_size = sizeof(active_transfer.received_command);
+        // Receive buffer needs to be read in (cleared by hw)
+        int dropped_bytes = 0;
+        while (i2c_get_read_available(i2c)) {
+            uint32_t raw_data_cmd = i2c->hw->data_cmd;
+            struct command_slot *slot = &command_slots[command_ring.recv_index];
+
+            bool can_process_data = true;
+            if (raw_data_cmd & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS) {
+                struct command_slot *responding_slot = async_i2c_responding_slot();
+                if (responding_slot) {
+                    async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_RESPONSE_DROPPED, 0);
+                    responding_slot->state = SLOT_FREE;
+                    async_i2c_release_finished_slots();
+                    hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+                }
 
-            // Receive buffer needs to be read in (cleared by hw)
-            int dropped_bytes = 0;
-            while (i2c_get_read_available(i2c)) {
-                uint32_t raw_data_cmd = i2c->hw->data_cmd;
+                if (slot->state == SLOT_RECEIVING){
+                    async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_COMMAND_DROPPED, 0);
+                } else if (command_ring.num_queued == ASYNC_I2C_TARGET_NUM_SLOTS) {
+                    async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_QUEUE_FULL, 0);
+                }
 
-                bool can_process_data = true;
-                if (raw_data_cmd & I2C_IC_DATA_CMD_FIRST_DATA_BYTE_BITS) {
-                    if (active_transfer.state != I2C_TARGET_IDLE){
-                        I2C_PROTOCOL_ERR("New command received before previous command finished... dropping previous command");
-                    }
-                    active_transfer.bytes_received = 0;
-                    active_transfer.recv_size = offsetof(actuator_i2c_cmd_t, cmd_id) + 1;
-                    active_transfer.state = I2C_TARGET_RECEIVING;
-                } else if (active_transfer.state == I2C_TARGET_IDLE){
-                    // If in idle state wait until start bit before reading data
-                    can_process_data = false;
+                if (command_ring.num_queued < ASYNC_I2C_TARGET_NUM_SLOTS) {
+                    slot->bytes_received = 0;
+                    slot->recv_size = offsetof(actuator_i2c_cmd_t, cmd_id) + 1;
+                    slot->state = SLOT_RECEIVING;
                 } else {
-                    can_process_data = (active_transfer.bytes_received < active_transfer.recv_size);
+                    can_process_data = false;
                 }
+            } else if (slot->state != SLOT_RECEIVING){
+                // If not receiving wait until start bit before reading data
+                can_process_data = false;
+            } else {
+                can_process_data = (slot->bytes_received < slot->recv_size);
+            }
 
-                if (can_process_data) {
-                    uint8_t data_byte = (uint8_t) raw_data_cmd;
+            if (can_process_data) {
+                uint8_t *raw_recv_buffer = (uint8_t*)(&slot->received_command);
+                __unused size_t max_recv_buffer_size = sizeof(slot->received_command);
+                uint8_t data_byte = (uint8_t) raw_data_cmd;
 
-                    if (active_transfer.bytes_received == offsetof(actuator_i2c_cmd_t, cmd_id)) {
-                        active_transfer.recv_size = ACTUATOR_GET_CMD_SIZE(data_byte);
+                if (slot->bytes_received == offsetof(actuator_i2c_cmd_t, cmd_id)) {
+                    slot->recv_size = ACTUATOR_GET_CMD_SIZE(data_byte);
+                }
+                if (slot->recv_size == 0){
+                    async_i2c_target_abort(i2c);
+                    async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_INVALID_COMMAND, data_byte);
+                } else {
+                    assert(slot->bytes_received < max_recv_buffer_size);
+                    raw_recv_buffer[slot->bytes_received++] = data_byte;
+
+                    // Batch frames are variable length, so extend the receive once the payload length is known
+                    if (slot->received_command.cmd_id == ACTUATOR_CMD_BATCH &&
+                            slot->bytes_received == offsetof(actuator_i2c_cmd_t, data.batch.payload)) {
+                        if (data_byte > ACTUATOR_BATCH_MAX_PAYLOAD) {
+                            async_i2c_target_abort(i2c);
+                            async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_BATCH_TOO_LONG, data_byte);
+                        } else {
+                            slot->recv_size += data_byte;
+                        }
                     }
-                    if (active_transfer.recv_size == 0){
-                        async_i2c_target_abort(i2c);
-                        I2C_PROTOCOL_ERR("Invalid command received %d", data_byte);
-                    } else {
-                        assert(active_transfer.bytes_received < max_recv_buffer_size);
-                        raw_recv_buffer[active_transfer.bytes_received++] = data_byte;
+
+                    // Complete the command as soon as its last byte arrives, as the fifo may already hold the start of the next command
+                    if (slot->state == SLOT_RECEIVING && slot->bytes_received == slot->recv_size) {
+                        async_i2c_complete_command(i2c, slot);
                     }
-                } else {
-                    dropped_bytes++;
                 }
+            } else {
+                dropped_bytes++;
             }
+        }
 
-            if (dropped_bytes > 0){
-                async_i2c_target_abort(i2c);
-                I2C_PROTOCOL_ERR("Dropping %d unexpected bytes", dropped_bytes);
-            }
+        if (dropped_bytes > 0){
+            async_i2c_target_abort(i2c);
+            async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_UNEXPECTED_BYTES, dropped_bytes);
+        }
 
-            if (active_transfer.state == I2C_TARGET_RECEIVING && active_transfer.bytes_received == active_transfer.recv_size) {
-                uint8_t calculated_crc = actuator_i2c_crc8_calc_command(&active_transfer.received_command, active_transfer.bytes_received);
-                if (calculated_crc == active_transfer.received_command.crc8) {
-                    LOG_DEBUG("Command received");
-                    active_transfer.state = I2C_TARGET_CMD_RECEIVED;
-                } else {
-                    async_i2c_target_abort(i2c);
-                    I2C_PROTOCOL_ERR("Invalid CRC on message, 0x%02x received, 0x%02x calculated", active_transfer.received_command.crc8, calculated_crc);
-                }
+        async_i2c_update_rx_threshold(i2c);
+    }
+
+    if (has_irq_pending(i2c, STOP_DET)) {
+        // End of a transfer addressed to this device
+        LOG_DEBUG("STOP_DET INT");
+        target_stats.stop_det_interrupts++;
+        i2c->hw->clr_stop_det;
+
+        // If the next transfer has already started then the stop belongs to an earlier frame
+        struct command_slot *slot = &command_slots[command_ring.recv_index];
+        if (slot->state == SLOT_RECEIVING && !(i2c->hw->status & I2C_IC_STATUS_SLV_ACTIVITY_BITS)) {
+            slot->state = SLOT_FREE;
+            async_i2c_update_rx_threshold(i2c);
+            async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_COMMAND_TERMINATED, slot->bytes_received);
+        }
+    }
+
+    if (has_irq_pending(i2c, RD_REQ)) {
+        // Read requested from device
+        LOG_DEBUG("RD_REQ INT");
+        target_stats.rd_req_interrupts++;
+        i2c->hw->clr_rd_req;
+
+        struct command_slot *slot = &command_slots[command_ring.respond_index];
+        if (command_ring.num_queued == 0) {
+            i2c->hw->data_cmd = 0xFF;
+            async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_UNEXPECTED_READ, 0);
+        } else if (slot->state == SLOT_RESPONDING) {
+            if (slot->bytes_sent < slot->response_size) {
+                async_i2c_fill_transmit_queue();
+            } else {
+                i2c->hw->data_cmd = 0xFF;
+                async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_TOO_MANY_BYTES_READ, 0);
             }
+        } else if (slot->state == SLOT_RESPONSE_READY) {
+            async_i2c_start_response();
         } else {
-            async_i2c_restart_hardware(i2c);
-            I2C_PROTOCOL_ERR("Data sent to device while busy with request, dropping data");
+            // Mark as waiting for response so when one is provided it gets immediately sent
+            command_ring.waiting_for_response = true;
         }
     }
 }
@@ -265,12 +457,21 @@ void async_i2c1_irq_handler(void) {
 }
 
 static void async_i2c_configure_interrupt_hw(i2c_inst_t *i2c) {
+    // Only report stops for transfers addressed to this device, as the bus is shared with other sensors
+    // Hold the bus when the rx fifo is full rather than overflowing, in case the interrupt is delayed
+    // IC_CON can only be written while the hardware is disabled
+    hw_clear_bits(&i2c->hw->enable, I2C_IC_ENABLE_ENABLE_BITS);
+    do {tight_loop_contents();} while(i2c->hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS);
+    hw_set_bits(&i2c->hw->con, I2C_IC_CON_STOP_DET_IFADDRESSED_BITS | I2C_IC_CON_RX_FIFO_FULL_HLD_CTRL_BITS);
+    hw_set_bits(&i2c->hw->enable, I2C_IC_ENABLE_ENABLE_BITS);
+    do {tight_loop_contents();} while(!(i2c->hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS));
+
     i2c->hw->intr_mask =  I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
                           I2C_IC_INTR_MASK_M_TX_OVER_BITS | I2C_IC_INTR_MASK_M_RX_OVER_BITS |
                           I2C_IC_INTR_MASK_M_RX_UNDER_BITS | I2C_IC_INTR_MASK_M_RD_REQ_BITS |
-                          I2C_IC_INTR_MASK_M_RX_DONE_BITS;
+                          I2C_IC_INTR_MASK_M_RX_DONE_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS;
 
-    i2c->hw->rx_tl = 0;
+    async_i2c_update_rx_threshold(i2c);
     i2c->hw->tx_tl = 6;
 }
 
@@ -279,28 +480,41 @@ static void async_i2c_configure_interrupt_hw(i2c_inst_t *i2c) {
 // ========================================
 
 bool async_i2c_target_get_next_command(actuator_i2c_cmd_t *cmd){
-    hard_assert_if(ASYNC_I2C_TARGET, active_transfer.state == I2C_TARGET_CMD_PROCESSING);
+    hard_assert_if(ASYNC_I2C_TARGET, command_ring.command_processing);
 
-    if (active_transfer.state == I2C_TARGET_CMD_RECEIVED || active_transfer.state == I2C_TARGET_WAITING_FOR_RESPONSE) {
-        memcpy(cmd, &active_transfer.received_command, active_transfer.bytes_received);
+    // Enter critical section to avoid race condition
+    uint32_t prev_interrupt = save_and_disable_interrupts();
 
-        // Enter critical section to avoid race condition
-        uint32_t prev_interrupt = save_and_disable_interrupts();
-        if (active_transfer.state != I2C_TARGET_WAITING_FOR_RESPONSE)
-            active_transfer.state = I2C_TARGET_CMD_PROCESSING;
-        restore_interrupts(prev_interrupt);
+    // Skip over commands which were already answered from the irq
+    while (command_ring.num_unprocessed > 0 && command_slots[command_ring.process_index].state != SLOT_RECEIVED) {
+        command_ring.process_index = async_i2c_next_slot(command_ring.process_index);
+        command_ring.num_unprocessed--;
+    }
 
+    struct command_slot *slot = &command_slots[command_ring.process_index];
+    bool has_command = (command_ring.num_unprocessed > 0);
+    if (has_command) {
+        slot->state = SLOT_PROCESSING;
+        command_ring.command_processing = true;
+        command_ring.processing_index = command_ring.process_index;
+        command_ring.process_index = async_i2c_next_slot(command_ring.process_index);
+        command_ring.num_unprocessed--;
+    }
+    restore_interrupts(prev_interrupt);
 
-        return true;
+    if (has_command) {
+        // The slot is not modified by the irq while processing
+        memcpy(cmd, &slot->received_command, slot->bytes_received);
     }
 
-    return false;
+    return has_command;
 }
 
 void async_i2c_target_finish_command(actuator_i2c_response_t *response, size_t size){
-    hard_assert_if(ASYNC_I2C_TARGET, active_transfer.state != I2C_TARGET_CMD_PROCESSING && active_transfer.state != I2C_TARGET_WAITING_FOR_RESPONSE);
-    hard_assert(size <= 65535);
+    hard_assert_if(ASYNC_I2C_TARGET, !command_ring.command_processing);
+    hard_assert(size <= sizeof(actuator_i2c_response_t));
 
+    struct command_slot *slot = &command_slots[command_ring.processing_index];
     bool has_response = (response != NULL && size > 0);
 
     if (has_response) {
@@ -308,31 +522,61 @@ void async_i2c_target_finish_command(actuator_i2c_response_t *response, size_t s
 
         response->crc8 = actuator_i2c_crc8_calc_response(response, size);
 
-        active_transfer.response = response;
-        active_transfer.response_size = size;
-        active_transfer.bytes_sent = 0;
+        memcpy(&slot->response, response, size);
+        slot->response_size = size;
+        slot->bytes_sent = 0;
     }
 
     // Enter critical section to avoid race condition
     uint32_t prev_interrupt = save_and_disable_interrupts();
 
-    bool needs_response = (active_transfer.state == I2C_TARGET_WAITING_FOR_RESPONSE);
-    active_transfer.state = (has_response ? I2C_TARGET_RESPONDING : I2C_TARGET_IDLE);
+    command_ring.command_processing = false;
+    slot->state = (has_response ? SLOT_RESPONSE_READY : SLOT_FREE);
+    async_i2c_release_finished_slots();
+
+    // If the controller is waiting, respond as soon as the oldest command has a response
+    // A read with no commands left to respond to can never be satisfied
+    bool needs_response = command_ring.waiting_for_response;
+    bool response_ready = (command_ring.num_queued > 0 && command_slots[command_ring.respond_index].state == SLOT_RESPONSE_READY);
+    bool response_missing = (command_ring.num_queued == 0);
+    if (needs_response && response_ready) {
+        async_i2c_start_response();
+    } else if (needs_response && response_missing) {
+        command_ring.waiting_for_response = false;
+    }
 
     restore_interrupts(prev_interrupt);
 
-    if (needs_response) {
-        if (has_response) {
-            async_i2c_fill_transmit_queue();
-            LOG_INFO("Filling queue");
-        } else {
-            I2C_PROTOCOL_ERR("I2C attempting to read response with no response to active command");
-            async_i2c_target_abort(i2c_inst);
-            i2c_inst->hw->data_cmd = 0xFF;  // Send a command since if waiting for a response the read req has been cleared
-        }
+    if (needs_response && response_ready) {
+        LOG_DEBUG("Filling queue");
+    } else if (needs_response && response_missing) {
+        async_i2c_target_record_error(ASYNC_I2C_TARGET_ERROR_NO_RESPONSE, 0);
+        async_i2c_target_abort(i2c_inst);
+        i2c_inst->hw->data_cmd = 0xFF;  // Send a command since if waiting for a response the read req has been cleared
     }
 }
 
+void async_i2c_target_set_status(actuator_i2c_response_t *response, size_t size) {
+    hard_assert(size <= sizeof(actuator_i2c_response_t));
+
+    // The inactive frame is never read by the irq, so it can be filled without disabling interrupts
+    uint frame = !status_cache.active_frame;
+    response->crc8 = actuator_i2c_crc8_calc_response(response, size);
+    memcpy(&status_cache.frames[frame], response, size);
+    status_cache.frame_sizes[frame] = size;
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    status_cache.active_frame = frame;
+    status_cache.valid = true;
+    restore_interrupts(prev_interrupt);
+}
+
+void async_i2c_target_get_stats(struct async_i2c_target_stats *stats) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = target_stats;
+    restore_interrupts(prev_interrupt);
+}
+
 void async_i2c_target_init(uint baudrate, uint8_t i2c_address) {
     invalid_params_if(ASYNC_I2C_TARGET, i2c_reserved_addr(i2c_address));
     LOG_DEBUG("Initializing I2C target with address 0x%02x", i2c_address);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "pico/stdio_usb.h"
 #include "hardware/i2c.h"
@@ -19,6 +20,10 @@
 
 #define USE_POWER_LED 0
 
+// The timings received from the copro, reported as a hash on request so the copro knows when to resend them
+// Timings are only recorded here once they have been successfully applied
+static struct timing_table_cmd received_timings = {0};
+
 static void populate_status_msg(struct actuator_i2c_status *status){
     // NOTE: The firmware version in the CMakeLists should match the expected firmware version in actuator_i2c/interface.h
     status->firmware_status.version_major = MAJOR_VERSION;
@@ -39,6 +44,223 @@ static void populate_status_msg(struct actuator_i2c_status *status){
     status->torpedo2_state = torpedo_get_state(2);
 }
 
+// The status served from the i2c interrupt, rebuilt whenever the actuator state changes
+static struct actuator_i2c_status cached_status = {0};
+static bool cached_status_valid = false;
+
+/**
+ * @brief Rebuilds the status, passing it to the i2c target if it has changed
+ */
+static void status_tick(void) {
+    // Zeroed so the unused status bits are deterministic, as the whole struct is compared and sent
+    actuator_i2c_response_t status_response = {0};
+    populate_status_msg(&status_response.data.status);
+
+    if (!cached_status_valid || memcmp(&status_response.data.status, &cached_status, sizeof(cached_status)) != 0) {
+        memcpy(&cached_status, &status_response.data.status, sizeof(cached_status));
+        cached_status_valid = true;
+        async_i2c_target_set_status(&status_response, ACTUATOR_STATUS_RESP_LENGTH);
+    }
+}
+
+/**
+ * @brief Sets a single torpedo timing, recording it in received_timings on success
+ */
+static enum actuator_command_result set_torpedo_timing(struct torpedo_timing_cmd *timing) {
+    enum actuator_command_result result = torpedo_set_timings(timing);
+    if (result == ACTUATOR_RESULT_SUCCESSFUL) {
+        if (timing->torpedo_num == 1) {
+            received_timings.torpedo1_timings_us[timing->timing_type] = timing->time_us;
+        } else {
+            received_timings.torpedo2_timings_us[timing->timing_type] = timing->time_us;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Applies every non-zero timing in the timing table
+ *
+ * @param table The timing table received
+ * @return enum actuator_command_result ACTUATOR_RESULT_SUCCESSFUL if all timings were applied, otherwise ACTUATOR_RESULT_FAILED
+ */
+static enum actuator_command_result set_timing_table(struct timing_table_cmd *table) {
+    enum actuator_command_result result = ACTUATOR_RESULT_SUCCESSFUL;
+
+    if (table->claw_open_time_ms != 0 && table->claw_close_time_ms != 0) {
+        struct claw_timing_cmd claw_timing = {.open_time_ms = table->claw_open_time_ms, .close_time_ms = table->claw_close_time_ms};
+        if (claw_set_timings(&claw_timing) == ACTUATOR_RESULT_SUCCESSFUL) {
+            received_timings.claw_open_time_ms = table->claw_open_time_ms;
+            received_timings.claw_close_time_ms = table->claw_close_time_ms;
+        } else {
+            result = ACTUATOR_RESULT_FAILED;
+        }
+    }
+
+    if (table->dropper_active_time_ms != 0) {
+        struct dropper_timing_cmd dropper_timing = {.active_time_ms = table->dropper_active_time_ms};
+        if (dropper_set_timings(&dropper_timing) == ACTUATOR_RESULT_SUCCESSFUL) {
+            received_timings.dropper_active_time_ms = table->dropper_active_time_ms;
+        } else {
+            result = ACTUATOR_RESULT_FAILED;
+        }
+    }
+
+    for (int i = 0; i < ACTUATOR_NUM_TORPEDO_TIMINGS; i++) {
+        struct torpedo_timing_cmd torpedo1_timing = {.torpedo_num = 1, .timing_type = i, .time_us = table->torpedo1_timings_us[i]};
+        struct torpedo_timing_cmd torpedo2_timing = {.torpedo_num = 2, .timing_type = i, .time_us = table->torpedo2_timings_us[i]};
+
+        if (torpedo1_timing.time_us != 0 && set_torpedo_timing(&torpedo1_timing) != ACTUATOR_RESULT_SUCCESSFUL) {
+            result = ACTUATOR_RESULT_FAILED;
+        }
+        if (torpedo2_timing.time_us != 0 && set_torpedo_timing(&torpedo2_timing) != ACTUATOR_RESULT_SUCCESSFUL) {
+            result = ACTUATOR_RESULT_FAILED;
+        }
+    }
+
+    return result;
+}
+
+static size_t process_batch_command(const struct batch_cmd *batch, actuator_i2c_response_t *response);
+
+/**
+ * @brief Runs a command received from the copro
+ *
+ * @param cmd The command to run
+ * @param response Output for the response to the command
+ * @return size_t The size of the response, or 0 if there is no response
+ */
+static size_t process_command(actuator_i2c_cmd_t *cmd, actuator_i2c_response_t *response) {
+    size_t response_size = 0;
+    switch (cmd->cmd_id) {
+        case ACTUATOR_CMD_GET_STATUS:
+            // Only reached for batches, single GET_STATUS commands are answered from the status cache
+            status_tick();
+            memcpy(&response->data.status, &cached_status, sizeof(cached_status));
+            response_size = ACTUATOR_STATUS_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_OPEN_CLAW:
+            response->data.result = claw_open();
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_CLOSE_CLAW:
+            response->data.result = claw_close();
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_CLAW_TIMING:
+            response->data.result = claw_set_timings(&cmd->data.claw_timing);
+            if (response->data.result == ACTUATOR_RESULT_SUCCESSFUL) {
+                received_timings.claw_open_time_ms = cmd->data.claw_timing.open_time_ms;
+                received_timings.claw_close_time_ms = cmd->data.claw_timing.close_time_ms;
+            }
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+
+        case ACTUATOR_CMD_ARM_TORPEDO:
+            response->data.result = torpedo_arm();
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_DISARM_TORPEDO:
+            response->data.result = torpedo_disarm();
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_FIRE_TORPEDO:
+            response->data.result = torpedo_fire(&cmd->data.fire_torpedo);
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_TORPEDO_TIMING:
+            response->data.result = set_torpedo_timing(&cmd->data.torpedo_timing);
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+
+        case ACTUATOR_CMD_DROP_MARKER:
+            response->data.result = dropper_drop_marker(&cmd->data.drop_marker);
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_CLEAR_DROPPER_STATUS:
+            response->data.result = dropper_clear_status();
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_DROPPER_TIMING:
+            response->data.result = dropper_set_timings(&cmd->data.dropper_timing);
+            if (response->data.result == ACTUATOR_RESULT_SUCCESSFUL) {
+                received_timings.dropper_active_time_ms = cmd->data.dropper_timing.active_time_ms;
+            }
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_TIMING_TABLE:
+            response->data.result = set_timing_table(&cmd->data.timing_table);
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+        case ACTUATOR_CMD_GET_TIMING_HASH:
+            response->data.timing_hash.timing_hash = actuator_i2c_timing_table_hash(&received_timings);
+            response_size = ACTUATOR_TIMING_HASH_RESP_LENGTH;
+            break;
+
+        case ACTUATOR_CMD_KILL_SWITCH:
+            safety_kill_switch_update(KILL_SWITCH_I2C_MSG, cmd->data.kill_switch.asserting_kill, true);
+            response->data.result = ACTUATOR_RESULT_SUCCESSFUL;
+            response_size = ACTUATOR_RESULT_RESP_LENGTH;
+            break;
+
+        case ACTUATOR_CMD_BATCH:
+            response_size = process_batch_command(&cmd->data.batch, response);
+            break;
+
+        case ACTUATOR_CMD_RESET_ACTUATORS:
+            LOG_INFO("Reboot command received");
+            safety_notify_software_reset();
+            watchdog_reboot(0, 0, 0);
+            break;
+
+        default:
+            LOG_WARN("Unknown command 0x%02x", cmd->cmd_id);
+            safety_raise_fault(FAULT_I2C_PROTO_ERROR);
+            break;
+    }
+
+    return response_size;
+}
+
+/**
+ * @brief Runs each command in a batch frame in order, packing their responses into a single response
+ *
+ * @param batch The batch frame received
+ * @param response Output for the combined response
+ * @return size_t The size of the response, or 0 if the batch is invalid
+ */
+static size_t process_batch_command(const struct batch_cmd *batch, actuator_i2c_response_t *response) {
+    size_t response_size;
+    if (batch->version != ACTUATOR_BATCH_VERSION) {
+        LOG_WARN("Unsupported batch version %d", batch->version);
+        safety_raise_fault(FAULT_I2C_PROTO_ERROR);
+        return 0;
+    }
+    if (!actuator_i2c_batch_get_response_size(batch, &response_size)) {
+        LOG_WARN("Invalid batch command received");
+        safety_raise_fault(FAULT_I2C_PROTO_ERROR);
+        return 0;
+    }
+
+    actuator_i2c_cmd_t entry;
+    actuator_i2c_response_t entry_response;
+    size_t offset = 0;
+    size_t response_offset = 0;
+    while (offset < batch->payload_length) {
+        size_t entry_size = actuator_i2c_batch_entry_size(batch->payload[offset]);
+        memcpy(&entry.cmd_id, &batch->payload[offset], entry_size);
+        offset += entry_size;
+
+        process_command(&entry, &entry_response);
+
+        size_t entry_response_size = actuator_i2c_batch_entry_response_size(entry.cmd_id);
+        memcpy(&response->data.batch[response_offset], &entry_response.data, entry_response_size);
+        response_offset += entry_response_size;
+    }
+
+    return response_size;
+}
+
 int main() {
     stdio_init_all();
     dual_usb_init();
@@ -53,7 +275,8 @@ int main() {
     gpio_put(LED_PIN, USE_POWER_LED);
     #endif
 
-    async_i2c_target_init(200000, ACTUATOR_I2C_ADDR);
+    // Configured for the copro's actuator bus speed (Fast-mode) so the spike filter and data hold times match
+    async_i2c_target_init(400000, ACTUATOR_I2C_ADDR);
 
     safety_init();
 
@@ -61,6 +284,8 @@ int main() {
     dropper_initialize();
     torpedo_initialize();
 
+    status_tick();
+
     actuator_i2c_cmd_t cmd;
     actuator_i2c_response_t response;
 
@@ -68,75 +293,10 @@ int main() {
         if (async_i2c_target_get_next_command(&cmd)) {
             LOG_DEBUG("Received Command: %d", cmd.cmd_id);
 
-            size_t response_size = 0;
-            switch (cmd.cmd_id) {
-                case ACTUATOR_CMD_GET_STATUS:
-                    populate_status_msg(&response.data.status);
-                    response_size = ACTUATOR_STATUS_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_OPEN_CLAW:
-                    response.data.result = claw_open();
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_CLOSE_CLAW:
-                    response.data.result = claw_close();
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_CLAW_TIMING:
-                    response.data.result = claw_set_timings(&cmd.data.claw_timing);
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-
-                case ACTUATOR_CMD_ARM_TORPEDO:
-                    response.data.result = torpedo_arm();
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_DISARM_TORPEDO:
-                    response.data.result = torpedo_disarm();
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_FIRE_TORPEDO:
-                    response.data.result = torpedo_fire(&cmd.data.fire_torpedo);
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_TORPEDO_TIMING:
-                    response.data.result = torpedo_set_timings(&cmd.data.torpedo_timing);
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-
-                case ACTUATOR_CMD_DROP_MARKER:
-                    response.data.result = dropper_drop_marker(&cmd.data.drop_marker);
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_CLEAR_DROPPER_STATUS:
-                    response.data.result = dropper_clear_status();
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-                case ACTUATOR_CMD_DROPPER_TIMING:
-                    response.data.result = dropper_set_timings(&cmd.data.dropper_timing);
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-
-                case ACTUATOR_CMD_KILL_SWITCH:
-                    safety_kill_switch_update(KILL_SWITCH_I2C_MSG, cmd.data.kill_switch.asserting_kill, true);
-                    response.data.result = ACTUATOR_RESULT_SUCCESSFUL;
-                    response_size = ACTUATOR_RESULT_RESP_LENGTH;
-                    break;
-
-                case ACTUATOR_CMD_RESET_ACTUATORS:
-                    LOG_INFO("Reboot command received");
-                    safety_notify_software_reset();
-                    watchdog_reboot(0, 0, 0);
-                    break;
-
-                default:
-                    LOG_WARN("Unknown command 0x%02x", cmd.cmd_id);
-                    safety_raise_fault(FAULT_I2C_PROTO_ERROR);
-                    break;
-            }
-
+            size_t response_size = process_command(&cmd, &response);
             async_i2c_target_finish_command(&response, response_size);
         }
+        status_tick();
         safety_tick();
     }
     return 0;
@@ -30,6 +30,7 @@
 struct adc_configuration {
     i2c_inst_t *i2c;
     uint8_t address;
+    enum async_i2c_speed speed;
     uint8_t poll_rate_ms;
     bool enable_temperature;
     bool external_vref;
@@ -11,9 +11,66 @@
 #define PARAM_ASSERTIONS_ENABLED_ASYNC_I2C 0
 #endif
 
+// PICO_CONFIG: ASYNC_I2C_USE_DMA, Pace async i2c transfers with DMA so each stage raises a single completion interrupt, type=bool, default=0, group=Copro
+#ifndef ASYNC_I2C_USE_DMA
+#define ASYNC_I2C_USE_DMA 0
+#endif
+
+// PICO_CONFIG: ASYNC_I2C_MAX_TRACKED_ADDRESSES, Maximum number of device addresses per bus that transaction statistics are kept for, type=int, default=8, group=Copro
+#ifndef ASYNC_I2C_MAX_TRACKED_ADDRESSES
+#define ASYNC_I2C_MAX_TRACKED_ADDRESSES 8
+#endif
+
+/**
+ * @brief Number of buckets in the per-address latency histograms
+ * Bucket i counts transactions which took less than (ASYNC_I2C_LATENCY_BUCKET_BASE_US << i) us, with the last bucket counting all longer transactions
+ */
+#define ASYNC_I2C_LATENCY_BUCKETS 8
+#define ASYNC_I2C_LATENCY_BUCKET_BASE_US 64
+
+/**
+ * @brief Number of abort sources tracked, one for each abort bit in the tx_abrt_source register
+ */
+#define ASYNC_I2C_NUM_ABORT_SOURCES 17
+
 // I2C Request Types
 struct async_i2c_request;
 
+/**
+ * @brief Priority classes for queued requests
+ * Requests in a higher priority class are always started before any queued lower priority request on the same bus
+ */
+enum async_i2c_priority {
+    ASYNC_I2C_PRIORITY_NORMAL = 0,
+    ASYNC_I2C_PRIORITY_HIGH = 1,
+
+    ASYNC_I2C_NUM_PRIORITIES
+};
+
+/**
+ * @brief Result of queuing a request
+ */
+enum async_i2c_enqueue_result {
+    ASYNC_I2C_ENQUEUE_OK = 0,           // The request was started or queued
+    ASYNC_I2C_ENQUEUE_COALESCED = 1,    // The request was still waiting in a queue, so it was merged with the queued request
+    ASYNC_I2C_ENQUEUE_QUEUE_FULL = 2,   // The queue for the request's priority is full and the request was dropped. The caller should retry later
+    ASYNC_I2C_ENQUEUE_IN_FLIGHT = 3,    // The request (or its chain) is already running on the bus, so it was not queued. Updated buffers will not be sent
+};
+
+/**
+ * @brief Bus speed profiles for requests
+ * The bus is switched to the request's speed before it is started, so each device can run at the fastest rate it supports.
+ * Fast-mode Plus requires the bus pull-ups to be sized for 1 MHz operation
+ */
+enum async_i2c_speed {
+    ASYNC_I2C_SPEED_DEFAULT = 0,    // The baudrate passed to async_i2c_init
+    ASYNC_I2C_SPEED_STANDARD = 1,   // 100 kHz
+    ASYNC_I2C_SPEED_FAST = 2,       // 400 kHz
+    ASYNC_I2C_SPEED_FAST_PLUS = 3,  // 1 MHz
+
+    ASYNC_I2C_NUM_SPEEDS
+};
+
 /**
  * @brief Typedef for callback to i2c function
  */
@@ -31,6 +88,9 @@ struct async_i2c_request {
     async_i2c_abort_cb_t failed_callback;
     const struct async_i2c_request *next_req_on_success;
     void* user_data;
+    enum async_i2c_priority priority;   // Only the priority of the first request in a chain is used
+    bool repeated_start;                // Issue the read after the write with a repeated start rather than a STOP
+    enum async_i2c_speed speed;         // Speed profile the request is performed at
 };
 
 /**
@@ -50,7 +110,10 @@ struct async_i2c_request {
     .completed_callback = fn_callback, \
     .failed_callback = NULL, \
     .next_req_on_success = NULL, \
-    .user_data = NULL}
+    .user_data = NULL, \
+    .priority = ASYNC_I2C_PRIORITY_NORMAL, \
+    .repeated_start = false, \
+    .speed = ASYNC_I2C_SPEED_DEFAULT}
 
 /**
  * @brief Creates a write request
@@ -58,7 +121,7 @@ struct async_i2c_request {
  * tx_buf must not be modified while in_progress is true
  * fn_callback is called on a successful request
  */
-#define ASYNC_I2C_WRITE_REQ(hw_id, address, tx_buf, tx_size, fn_callback) {\
+#define ASYNC_I2C_WRITE_REQ(i2c_inst, target_address, tx_buf, tx_size, fn_callback) {\
     .i2c = i2c_inst, \
     .address = target_address, \
     .nostop = false, \
@@ -68,8 +131,11 @@ struct async_i2c_request {
     .bytes_to_receive = 0, \
     .completed_callback = fn_callback, \
     .failed_callback = NULL, \
-    .next_req_on_success = NULL \
-    .user_data = NULL}
+    .next_req_on_success = NULL, \
+    .user_data = NULL, \
+    .priority = ASYNC_I2C_PRIORITY_NORMAL, \
+    .repeated_start = false, \
+    .speed = ASYNC_I2C_SPEED_DEFAULT}
 
 /**
  * @brief Creates a read request
@@ -87,10 +153,150 @@ struct async_i2c_request {
     .bytes_to_receive = rx_size, \
     .completed_callback = fn_callback, \
     .failed_callback = NULL, \
-    .next_req_on_success = NULL \
-    .user_data = NULL}
+    .next_req_on_success = NULL, \
+    .user_data = NULL, \
+    .priority = ASYNC_I2C_PRIORITY_NORMAL, \
+    .repeated_start = false, \
+    .speed = ASYNC_I2C_SPEED_DEFAULT}
+
 
 
+// Transaction Scripts
+struct async_i2c_script_state;
+
+/**
+ * @brief Operations which can be performed by a step in a transaction script
+ * ASYNC_I2C_SCRIPT_OP_TRANSFER: Writes and/or reads data from the device
+ * ASYNC_I2C_SCRIPT_OP_DELAY: Waits delay_us before the next step. The bus is released while waiting
+ * ASYNC_I2C_SCRIPT_OP_BRANCH_ON_FAILURE: Jumps to target_step if the previous transfer failed, otherwise does nothing
+ */
+enum async_i2c_script_op {
+    ASYNC_I2C_SCRIPT_OP_TRANSFER,
+    ASYNC_I2C_SCRIPT_OP_DELAY,
+    ASYNC_I2C_SCRIPT_OP_BRANCH_ON_FAILURE,
+};
+
+/**
+ * @brief The number of failed transfers a single run of a script can branch on before failing
+ * Prevents a retry loop in a script from running forever
+ */
+#define ASYNC_I2C_SCRIPT_MAX_FAILURES 3
+
+struct async_i2c_script_step {
+    enum async_i2c_script_op op;
+    const uint8_t *tx_buffer;
+    uint8_t *rx_buffer;
+    uint16_t bytes_to_send;
+    uint16_t bytes_to_receive;
+    uint32_t delay_us;
+    uint8_t target_step;
+};
+
+#define ASYNC_I2C_SCRIPT_WRITE(tx_buf, tx_size) {.op = ASYNC_I2C_SCRIPT_OP_TRANSFER, .tx_buffer = tx_buf, .bytes_to_send = tx_size}
+#define ASYNC_I2C_SCRIPT_READ(rx_buf, rx_size) {.op = ASYNC_I2C_SCRIPT_OP_TRANSFER, .rx_buffer = rx_buf, .bytes_to_receive = rx_size}
+#define ASYNC_I2C_SCRIPT_WRITE_READ(tx_buf, rx_buf, tx_size, rx_size) {.op = ASYNC_I2C_SCRIPT_OP_TRANSFER, \
+    .tx_buffer = tx_buf, .rx_buffer = rx_buf, .bytes_to_send = tx_size, .bytes_to_receive = rx_size}
+#define ASYNC_I2C_SCRIPT_DELAY(time_us) {.op = ASYNC_I2C_SCRIPT_OP_DELAY, .delay_us = time_us}
+#define ASYNC_I2C_SCRIPT_BRANCH_ON_FAILURE(step) {.op = ASYNC_I2C_SCRIPT_OP_BRANCH_ON_FAILURE, .target_step = step}
+
+typedef void (*async_i2c_script_cb_t)(const struct async_i2c_script_state *);
+typedef void (*async_i2c_script_abort_cb_t)(const struct async_i2c_script_state *, uint32_t);
+
+/**
+ * @brief A static sequence of steps performed on a single device
+ * The steps are run by the driver, so the callbacks are only called once the whole script completes or fails
+ */
+struct async_i2c_script {
+    i2c_inst_t *i2c;
+    uint8_t address;
+    enum async_i2c_priority priority;
+    bool repeated_start;    // Transfer steps which both write and read use a repeated start between the stages
+    enum async_i2c_speed speed;
+    const struct async_i2c_script_step *steps;
+    uint8_t num_steps;
+    async_i2c_script_cb_t completed_callback;
+    async_i2c_script_abort_cb_t failed_callback;
+    void *user_data;
+};
+
+/**
+ * @brief The state of a running script. Owned by the caller but should only be modified by the driver
+ */
+struct async_i2c_script_state {
+    const struct async_i2c_script *script;
+    bool *in_progress;
+    uint8_t step;
+    uint8_t failures;
+
+    struct async_i2c_request request;
+    bool request_in_progress;
+};
+
+/**
+ * @brief Interrupt statistics for a single i2c bus
+ */
+struct async_i2c_irq_stats {
+    uint32_t transactions;              // Number of requests completed or aborted on the bus
+    uint32_t interrupts;                // Total number of interrupts serviced on the bus
+    uint16_t last_request_interrupts;   // Number of interrupts serviced by the most recent request
+    uint16_t max_request_interrupts;    // Largest number of interrupts serviced by a single request
+};
+
+/**
+ * @brief Queue wait statistics for a single priority class on an i2c bus
+ */
+struct async_i2c_queue_stats {
+    uint32_t requests;      // Number of requests started from this priority class
+    uint32_t coalesced;     // Number of requests merged into an identical pending request
+    uint32_t rejected;      // Number of requests dropped because the queue was full
+    uint32_t last_wait_us;  // Time the most recently started request waited before being started
+    uint32_t max_wait_us;   // Longest time a request waited before being started
+};
+
+/**
+ * @brief Transaction timing statistics for a single speed profile on an i2c bus
+ */
+struct async_i2c_speed_stats {
+    uint32_t requests;              // Number of requests completed or aborted at this speed
+    uint32_t baudrate;              // The actual baudrate the controller was configured for, or 0 if never used
+    uint32_t last_transaction_us;   // Time from start to completion of the most recent request
+    uint32_t max_transaction_us;    // Longest time from start to completion of a single request
+};
+
+/**
+ * @brief Bus recovery statistics for a single i2c bus
+ */
+struct async_i2c_recovery_stats {
+    uint32_t recoveries;            // Number of times the bus was recovered after being held by a target
+    uint32_t failed_recoveries;     // Number of recoveries where the bus lines were still held afterwards
+    uint32_t last_recovery_us;      // Time taken by the most recent recovery
+    uint32_t max_recovery_us;       // Longest time taken by a single recovery
+};
+
+/**
+ * @brief Transaction statistics for a single device address on an i2c bus
+ */
+struct async_i2c_address_stats {
+    uint8_t address;
+    uint32_t transactions;      // Number of requests completed or aborted to the address
+    uint32_t failures;          // Number of requests to the address that aborted
+    uint32_t latency_histogram[ASYNC_I2C_LATENCY_BUCKETS];
+};
+
+/**
+ * @brief Usage statistics for a single i2c bus
+ * Utilization can be calculated from the change in busy_time_us over the change in sample_time_us between two reads
+ */
+struct async_i2c_bus_stats {
+    uint64_t sample_time_us;    // Time since boot when the statistics were copied
+    uint64_t busy_time_us;      // Total time the bus has spent performing requests or recovering
+    uint32_t transactions;      // Number of requests completed or aborted on the bus
+    uint32_t failures;          // Number of requests that aborted
+    uint32_t abort_counts[ASYNC_I2C_NUM_ABORT_SOURCES];     // Number of aborts for each bit in tx_abrt_source
+    uint8_t num_addresses;      // Number of valid entries in addresses
+    uint32_t untracked_transactions;    // Requests to addresses after ASYNC_I2C_MAX_TRACKED_ADDRESSES were already tracked
+    struct async_i2c_address_stats addresses[ASYNC_I2C_MAX_TRACKED_ADDRESSES];
+};
 
 /**
  * @brief Bool if async_i2c_init has been called
@@ -99,6 +305,10 @@ extern bool async_i2c_initialized;
 
 /**
  * @brief Queues an async i2c request
+ * Each i2c hardware block has its own queue, so requests on separate busses run concurrently
+ * Enqueuing a request that is still waiting in a queue with the same in_progress pointer is merged with the queued request,
+ * so periodic pollers do not need to check if the previous poll has started. If the request is already running on the bus
+ * it is not queued again, and ASYNC_I2C_ENQUEUE_IN_FLIGHT is returned so the caller can resend once it finishes
  * 
  * INITIALIZATION REQUIRED
  * INTERRUPT SAFE
@@ -106,13 +316,91 @@ extern bool async_i2c_initialized;
  * @param request Struct if request is true
  * @param in_progress Pointer to be true while request is in progress (and buffers should not be modified)
  * Note that in_progress will be true while next_req_on_success is being processed as well
+ * @return enum async_i2c_enqueue_result If the request was queued, merged, already running, or dropped due to the queue being full
+ */
+enum async_i2c_enqueue_result async_i2c_enqueue(const struct async_i2c_request *request, bool *in_progress);
+
+/**
+ * @brief Runs a transaction script
+ * Each transfer step is queued as its own request, so other requests may run between steps
+ *
+ * INITIALIZATION REQUIRED
+ * INTERRUPT SAFE
+ *
+ * @param script The script to run
+ * @param state Storage for the state of the running script. Must not be modified while in_progress is true
+ * @param in_progress Pointer to be true while the script is running (and buffers should not be modified)
+ */
+void async_i2c_run_script(const struct async_i2c_script *script, struct async_i2c_script_state *state, bool *in_progress);
+
+/**
+ * @brief Copies the interrupt statistics for the given bus
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to get the statistics for
+ * @param stats Output for the statistics
+ */
+void async_i2c_get_irq_stats(i2c_inst_t *i2c, struct async_i2c_irq_stats *stats);
+
+/**
+ * @brief Copies the queue wait statistics for a priority class on the given bus
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to get the statistics for
+ * @param priority The priority class to get the statistics for
+ * @param stats Output for the statistics
+ */
+void async_i2c_get_queue_stats(i2c_inst_t *i2c, enum async_i2c_priority priority, struct async_i2c_queue_stats *stats);
+
+/**
+ * @brief Copies the usage statistics for the given bus
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to get the statistics for
+ * @param stats Output for the statistics
+ */
+void async_i2c_get_bus_stats(i2c_inst_t *i2c, struct async_i2c_bus_stats *stats);
+
+/**
+ * @brief Copies the bus recovery statistics for the given bus
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to get the statistics for
+ * @param stats Output for the statistics
+ */
+void async_i2c_get_recovery_stats(i2c_inst_t *i2c, struct async_i2c_recovery_stats *stats);
+
+/**
+ * @brief Copies the transaction timing statistics for a speed profile on the given bus
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to get the statistics for
+ * @param speed The speed profile to get the statistics for
+ * @param stats Output for the statistics
+ */
+void async_i2c_get_speed_stats(i2c_inst_t *i2c, enum async_i2c_speed speed, struct async_i2c_speed_stats *stats);
+
+/**
+ * @brief Returns if the given bus has no active request
+ * A new request may be queued at any time, so interrupts must be disabled for the result to stay valid
+ *
+ * INTERRUPT SAFE
+ *
+ * @param i2c The i2c bus to check
+ * @return true No request is running or queued on the bus
+ * @return false The bus is in use
  */
-void async_i2c_enqueue(const struct async_i2c_request *request, bool *in_progress);
+bool async_i2c_bus_idle(i2c_inst_t *i2c);
 
 /**
  * @brief Initialize async i2c and the corresponding i2c hardware
  * 
- * @param baudrate The data rate of the i2c bus in Hz
+ * @param baudrate The data rate of the i2c bus in Hz for requests using ASYNC_I2C_SPEED_DEFAULT
  * @param bus_timeout_ms The timeout from start of a transaction in ms
  */
 void async_i2c_init(uint baudrate, uint bus_timeout_ms);
@@ -5,6 +5,35 @@
 
 #include "actuator_i2c/interface.h"
 
+// PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_ACTUATOR, Enable/disable assertions in the Actuator module, type=bool, default=0, group=Copro
+#ifndef PARAM_ASSERTIONS_ENABLED_ACTUATOR
+#define PARAM_ASSERTIONS_ENABLED_ACTUATOR 0
+#endif
+
+/**
+ * @brief Usage of the statically allocated actuator command pool
+ */
+struct actuator_command_pool_stats {
+    uint32_t in_use;
+    uint32_t high_water_mark;
+    uint32_t allocation_failures;
+};
+
+/**
+ * @brief Round trip statistics for a single actuator command id
+ * Latency is measured from the command being queued to its response being validated
+ */
+struct actuator_command_stats {
+    uint32_t sent;
+    uint32_t completed;         // Responses that passed the crc check
+    uint32_t crc_errors;
+    uint32_t failed;            // Commands aborted on the bus or unable to be queued
+    uint32_t failed_results;    // Responses reporting a failed result
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
+    uint64_t latency_total_us;  // Divide by completed for the mean latency
+};
+
 /**
  * @brief If the actuator interface is initialized
  */
@@ -15,6 +44,11 @@ extern bool actuator_initialized;
  */
 extern struct actuator_i2c_status actuator_last_status;
 
+/**
+ * @brief The number of parameters registered by actuator_create_parameters
+ */
+#define ACTUATOR_NUM_PARAMETERS 12
+
 /**
  * @brief Creates the required parameters for the actuators on the provided parameter server
  * 
@@ -39,6 +73,22 @@ bool actuator_handle_parameter_change(Parameter * param);
  */
 bool actuator_is_connected(void);
 
+/**
+ * @brief Gets the usage of the actuator command pool
+ * 
+ * @param stats_out Output for the pool usage
+ */
+void actuator_get_command_pool_stats(struct actuator_command_pool_stats *stats_out);
+
+/**
+ * @brief Gets the round trip statistics for a command id
+ * Batched commands are recorded under ACTUATOR_CMD_BATCH
+ * 
+ * @param cmd_id The command id to get statistics for. Must be less than ACTUATOR_NUM_COMMANDS
+ * @param stats_out Output for the command statistics
+ */
+void actuator_get_command_stats(enum actuator_command cmd_id, struct actuator_command_stats *stats_out);
+
 /**
  * @brief Initializes actuator board communication.
  */
@@ -51,8 +101,7 @@ void actuator_kill_report_refresh(void);
 
 /**
  * @brief Actuator commands
- * 
- * NOT INTERRUPT SAFE - Can allocate memory
+ * Commands are taken from a fixed pool, raising FAULT_ACTUATOR_FAIL if none are free
  */
 void actuator_open_claw(void);
 void actuator_close_claw(void);
@@ -3,12 +3,20 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <rclc_parameter/rclc_parameter.h>
+
+#include "hw/depth_sensor_math.h"
 
 // PICO_CONFIG: PARAM_ASSERTIONS_ENABLED_DEPTH, Enable/disable assertions in the Depth Sensor module, type=bool, default=0, group=Copro
 #ifndef PARAM_ASSERTIONS_ENABLED_DEPTH
 #define PARAM_ASSERTIONS_ENABLED_DEPTH 0
 #endif
 
+// PICO_CONFIG: DEPTH_TEMPERATURE_INTERVAL, Number of depth samples per temperature conversion. Pressure is compensated with the last temperature between conversions, type=int, default=20, min=1, group=Copro
+#ifndef DEPTH_TEMPERATURE_INTERVAL
+#define DEPTH_TEMPERATURE_INTERVAL 20
+#endif
+
 /**
  * @brief Boolean for if depth is initialized.
  * This will be false until all calibration and zeroing is complete
@@ -21,10 +29,37 @@ extern bool depth_initialized;
  * 
  * REQUIRES INITIALIZATION
  * 
- * @return double The raw depth reading
+ * @return double The raw depth reading in meters
  */
 double depth_read(void);
 
+/**
+ * @brief Reads the value from the depth sensor in integer millimeters
+ * Calculated in fixed point, so this should be preferred over depth_read where possible
+ * 
+ * REQUIRES INITIALIZATION
+ * 
+ * @return int32_t The raw depth reading in millimeters
+ */
+int32_t depth_read_mm(void);
+
+/**
+ * @brief Returns the filtered depth and vertical velocity from the estimator
+ * The estimator runs on every depth sample, with variances calculated from the measured noise of the readings
+ * 
+ * REQUIRES INITIALIZATION
+ * 
+ * @param estimate Output for the current estimate
+ */
+void depth_get_estimate(struct depth_estimate *estimate);
+
+/**
+ * @brief Returns the number of samples lost to failed reads of the depth sensor after initialization
+ *
+ * @return uint32_t The number of failed samples
+ */
+uint32_t depth_get_failed_sample_count(void);
+
 /**
  * @brief Returns the current temperature read from the depth sensor
  * 
@@ -34,6 +69,35 @@ double depth_read(void);
  */
 float depth_get_temperature(void);
 
+/**
+ * @brief The number of parameters registered by depth_create_parameters
+ */
+#define DEPTH_NUM_PARAMETERS 2
+
+/**
+ * @brief Creates the fluid density and gravity parameters used for the depth conversion on the provided parameter server
+ * 
+ * @param param_server The server to add the parameters to
+ * @return rcl_ret_t Return code
+ */
+rcl_ret_t depth_create_parameters(rclc_parameter_server_t *param_server);
+
+/**
+ * @brief Function callback for parameter change and updates it if matches a depth parameter.
+ * The parameters are saved to persist watchdog resets
+ * 
+ * @param param The parameter that was updated
+ * @return true The parameter was a depth parameter and was valid
+ * @return false The parameter was not handled
+ */
+bool depth_handle_parameter_change(Parameter * param);
+
+/**
+ * @brief Ticks the depth sensor, saving a new surface pressure to flash once zeroing has finished
+ * Writing flash stalls execution, so the write waits until the kill switch is asserting kill and should only be called from the main loop
+ */
+void depth_tick(void);
+
 /**
  * @brief Begins initialization of depth sensor
  * 
@@ -9,16 +9,16 @@
 
 // Dirty hack to allow commands to be in separate header file
 static void depth_init_failure(const struct async_i2c_request *req, uint32_t abort_data);
-static void depth_read_failure(const struct async_i2c_request *req, uint32_t abort_data);
+static void depth_read_failure(const struct async_i2c_script_state *state, uint32_t abort_data);
 
 static void depth_reset_finished(const struct async_i2c_request *req);
 static void depth_prom_read_finished(const struct async_i2c_request *req);
-static void depth_convert_cmd_finished(const struct async_i2c_request *req);
-static void depth_adc_read_finished(const struct async_i2c_request *req);
+static void depth_sample_finished(const struct async_i2c_script_state *state);
 
 
 #define DEPTH_I2C_BUS SENSOR_I2C_HW
 #define DEPTH_I2C_ADDR 0x76
+#define DEPTH_I2C_SPEED ASYNC_I2C_SPEED_FAST
 
 #define DEPTH_CMD_RESET 0x1E
 #define DEPTH_CMD_CONVERT_D1(oversampling) (0x40+(oversampling << 1))
@@ -30,6 +30,7 @@ static void depth_adc_read_finished(const struct async_i2c_request *req);
 #define DEPTH_PROM_ID_MASK     0b0000111111100000
 
 #define DEPTH_OVERSAMPLING 5
+#define DEPTH_CONVERSION_TIME_US ((((int)(2.5e-3 * (1<<(8+DEPTH_OVERSAMPLING)))) + 2) * 1000)
 
 static const uint8_t reset_cmd[] = {DEPTH_CMD_RESET};
 static const struct async_i2c_request reset_req = {
@@ -42,7 +43,8 @@ static const struct async_i2c_request reset_req = {
     .bytes_to_receive = 0,
     .completed_callback = &depth_reset_finished,
     .failed_callback = &depth_init_failure,
-    .next_req_on_success = NULL
+    .next_req_on_success = NULL,
+    .speed = DEPTH_I2C_SPEED
 };
 
 // Note all prom reads will use this command
@@ -59,51 +61,64 @@ static const struct async_i2c_request prom_read_req = {
     .bytes_to_receive = sizeof(prom_read_data),
     .completed_callback = &depth_prom_read_finished,
     .failed_callback = &depth_init_failure,
-    .next_req_on_success = NULL
+    .next_req_on_success = NULL,
+    .speed = DEPTH_I2C_SPEED
 };
 
 
 static const uint8_t d1_convert_cmd[] = {DEPTH_CMD_CONVERT_D1(DEPTH_OVERSAMPLING)};
-static const struct async_i2c_request d1_convert_req = {
-    .i2c = DEPTH_I2C_BUS,
-    .address = DEPTH_I2C_ADDR,
-    .nostop = false,
-    .tx_buffer = d1_convert_cmd,
-    .rx_buffer = NULL,
-    .bytes_to_send = sizeof(d1_convert_cmd),
-    .bytes_to_receive = 0,
-    .completed_callback = &depth_convert_cmd_finished,
-    .failed_callback = &depth_read_failure,
-    .next_req_on_success = NULL
+static const uint8_t d2_convert_cmd[] = {DEPTH_CMD_CONVERT_D2(DEPTH_OVERSAMPLING)};
+static const uint8_t adc_read_cmd[] = {DEPTH_CMD_ADC_READ};
+static uint8_t d1_read_data[3];
+static uint8_t d2_read_data[3];
+
+// Performs a D1 (pressure) sample only, using the cached temperature compensation
+// A failed conversion command is retried, since the sensor has not started converting yet
+static const struct async_i2c_script_step depth_pressure_sample_steps[] = {
+    ASYNC_I2C_SCRIPT_WRITE(d1_convert_cmd, sizeof(d1_convert_cmd)),
+    ASYNC_I2C_SCRIPT_BRANCH_ON_FAILURE(0),
+    ASYNC_I2C_SCRIPT_DELAY(DEPTH_CONVERSION_TIME_US),
+    ASYNC_I2C_SCRIPT_WRITE_READ(adc_read_cmd, d1_read_data, sizeof(adc_read_cmd), sizeof(d1_read_data)),
 };
 
-static const uint8_t d2_convert_cmd[] = {DEPTH_CMD_CONVERT_D2(DEPTH_OVERSAMPLING)};
-static const struct async_i2c_request d2_convert_req = {
+// Performs a D2 (temperature) sample followed by a D1 (pressure) sample
+// Temperature is read first so the pressure is compensated with the new temperature
+static const struct async_i2c_script_step depth_full_sample_steps[] = {
+    ASYNC_I2C_SCRIPT_WRITE(d2_convert_cmd, sizeof(d2_convert_cmd)),
+    ASYNC_I2C_SCRIPT_BRANCH_ON_FAILURE(0),
+    ASYNC_I2C_SCRIPT_DELAY(DEPTH_CONVERSION_TIME_US),
+    ASYNC_I2C_SCRIPT_WRITE_READ(adc_read_cmd, d2_read_data, sizeof(adc_read_cmd), sizeof(d2_read_data)),
+
+    ASYNC_I2C_SCRIPT_WRITE(d1_convert_cmd, sizeof(d1_convert_cmd)),
+    ASYNC_I2C_SCRIPT_BRANCH_ON_FAILURE(4),
+    ASYNC_I2C_SCRIPT_DELAY(DEPTH_CONVERSION_TIME_US),
+    ASYNC_I2C_SCRIPT_WRITE_READ(adc_read_cmd, d1_read_data, sizeof(adc_read_cmd), sizeof(d1_read_data)),
+};
+
+static const struct async_i2c_script depth_pressure_sample_script = {
     .i2c = DEPTH_I2C_BUS,
     .address = DEPTH_I2C_ADDR,
-    .nostop = false,
-    .tx_buffer = d2_convert_cmd,
-    .rx_buffer = NULL,
-    .bytes_to_send = sizeof(d2_convert_cmd),
-    .bytes_to_receive = 0,
-    .completed_callback = &depth_convert_cmd_finished,
+    .priority = ASYNC_I2C_PRIORITY_NORMAL,
+    .repeated_start = false,
+    .speed = DEPTH_I2C_SPEED,
+    .steps = depth_pressure_sample_steps,
+    .num_steps = sizeof(depth_pressure_sample_steps) / sizeof(*depth_pressure_sample_steps),
+    .completed_callback = &depth_sample_finished,
     .failed_callback = &depth_read_failure,
-    .next_req_on_success = NULL
+    .user_data = NULL
 };
 
-static const uint8_t adc_read_cmd[] = {DEPTH_CMD_ADC_READ};
-static uint8_t adc_read_data[3];
-static const struct async_i2c_request adc_read_req = {
+static const struct async_i2c_script depth_full_sample_script = {
     .i2c = DEPTH_I2C_BUS,
     .address = DEPTH_I2C_ADDR,
-    .nostop = false,
-    .tx_buffer = adc_read_cmd,
-    .rx_buffer = adc_read_data,
-    .bytes_to_send = sizeof(adc_read_cmd),
-    .bytes_to_receive = sizeof(adc_read_data),
-    .completed_callback = &depth_adc_read_finished,
+    .priority = ASYNC_I2C_PRIORITY_NORMAL,
+    .repeated_start = false,
+    .speed = DEPTH_I2C_SPEED,
+    .steps = depth_full_sample_steps,
+    .num_steps = sizeof(depth_full_sample_steps) / sizeof(*depth_full_sample_steps),
+    .completed_callback = &depth_sample_finished,
     .failed_callback = &depth_read_failure,
-    .next_req_on_success = NULL
+    .user_data = NULL
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef _DEPTH_SENSOR_MATH_H
+#define _DEPTH_SENSOR_MATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Calculations for the depth sensor which don't touch hardware, kept separate so they can be built and tested on the host
+
+/**
+ * @brief The polling rate in milliseconds for how often the depth should refresh
+ * This should be longer than a pressure only sample. Polls which occur while a sample is still running are skipped
+ * The estimator runs at a fixed rate of one step per polling period
+ */
+#define DEPTH_POLLING_RATE_MS 25
+
+/**
+ * @brief The minimum and maximum number of samples used to zero the sensor
+ */
+#define DEPTH_ZERO_MIN_SAMPLES 5
+#define DEPTH_ZERO_MAX_SAMPLES 20
+/**
+ * @brief Samples further than this from the median in mbar are rejected as outliers
+ */
+#define DEPTH_ZERO_OUTLIER_MBAR 5
+/**
+ * @brief Zeroing has converged once the variance of the accepted samples is at or below this in mbar^2
+ */
+#define DEPTH_ZERO_CONVERGED_VARIANCE 1
+
+/**
+ * @brief Filtered depth state from the on-board estimator
+ * Depth is positive downwards
+ */
+struct depth_estimate {
+    int32_t depth_mm;
+    int32_t velocity_mm_s;
+    uint32_t depth_variance_mm2;
+    uint32_t velocity_variance_mm2_s2;
+    // The time in us since boot that the latest sample in the estimate was acquired
+    uint64_t sample_time_us;
+    // The number of samples taken, to detect when no new sample has been taken since the last estimate
+    uint32_t sample_count;
+};
+
+/**
+ * @brief Temperature compensation values, calculated from a D2 conversion
+ * The compensation values only depend on temperature, so they are reused for the pressure samples until the next D2 conversion
+ */
+struct depth_compensation {
+    // The temperature in hundreds of deg C
+    int32_t temperature;
+    // The second order compensated offset
+    int64_t off2;
+    // The second order compensated sensitivity
+    int64_t sens2;
+};
+
+/**
+ * @brief The depth in mm for each mbar above surface pressure, 100000 / (density * gravity), in 32.64 fixed point
+ * The 64 fractional bits keep the truncated depth exact for every pressure within +-40 bar and every accepted fluid parameter
+ */
+struct depth_conversion {
+    uint32_t mm_per_mbar_int;
+    uint64_t mm_per_mbar_frac;
+};
+
+/**
+ * @brief The samples taken so far during zeroing, sorted so the median can be found
+ */
+struct depth_zero_samples {
+    int32_t samples[DEPTH_ZERO_MAX_SAMPLES];
+    int count;
+};
+
+enum depth_zero_result {
+    DEPTH_ZERO_NEEDS_SAMPLES = 0,   // Another sample is needed
+    DEPTH_ZERO_CONVERGED = 1,       // The surface pressure is ready
+    DEPTH_ZERO_NOT_CONVERGED = 2,   // DEPTH_ZERO_MAX_SAMPLES were taken without converging, the surface pressure is the best estimate
+};
+
+/**
+ * @brief State of the alpha-beta filter estimating depth and velocity
+ */
+struct depth_estimator {
+    bool running;
+    uint64_t last_update_us;
+    // The estimated depth in mm with DEPTH_ESTIMATOR_FRAC_BITS fractional bits
+    int32_t depth;
+    // The estimated velocity in mm per sample period with DEPTH_ESTIMATOR_FRAC_BITS fractional bits
+    int32_t velocity;
+    // The running average of the squared residual in mm^2
+    uint32_t residual_variance;
+};
+
+/**
+ * @brief Does calculations with PROM and the D2 ADC reading to calculate the temperature and the compensation values
+ * Taken from the datasheet (And previous python firmware)
+ *
+ * @param prom The PROM read from the sensor
+ * @param D2 The ADC reading of the D2 Conversion
+ * @param compensation Output for the temperature and compensation values
+ */
+void depth_calculate_compensation(const uint16_t prom[8], uint32_t D2, struct depth_compensation *compensation);
+
+/**
+ * @brief Calculates the pressure from the D1 ADC reading using the compensation values
+ * Matches the datasheet calculation exactly, with the divides done as shifts
+ *
+ * @param compensation The compensation values from the last D2 conversion
+ * @param D1 The ADC reading of the D1 Conversion
+ * @return int32_t The pressure in mbar
+ */
+int32_t depth_calculate_pressure_mbar(const struct depth_compensation *compensation, uint32_t D1);
+
+/**
+ * @brief Calculates the depth conversion for the fluid parameters
+ * Calculated once whenever the fluid parameters change, so that the depth calculation needs no division
+ *
+ * @param density The fluid density in tenths of kg/m^3
+ * @param gravity The gravity in 1e-5 m/s^2
+ * @param conversion Output for the depth conversion
+ */
+void depth_calculate_conversion(uint32_t density, uint32_t gravity, struct depth_conversion *conversion);
+
+/**
+ * @brief Converts a pressure above the surface pressure to depth
+ *
+ * @param conversion The depth conversion for the fluid
+ * @param pressure_diff The pressure above the surface pressure in mbar
+ * @return int32_t The depth in mm
+ */
+int32_t depth_pressure_to_mm(const struct depth_conversion *conversion, int32_t pressure_diff);
+
+/**
+ * @brief Adds a sample to zeroing
+ * The samples furthest from the median are rejected, and zeroing finishes once the rest have converged
+ *
+ * @param zero The samples taken so far. Set count to 0 to start zeroing
+ * @param pressure The pressure sample in mbar
+ * @param surface_pressure Output for the surface pressure in mbar, set once zeroing has finished
+ * @return enum depth_zero_result If zeroing has finished
+ */
+enum depth_zero_result depth_zero_add_sample(struct depth_zero_samples *zero, int32_t pressure, int32_t *surface_pressure);
+
+/**
+ * @brief Runs the alpha-beta filter with the latest depth reading
+ * Skipped polls are predicted over multiple steps. Gaps longer than DEPTH_ESTIMATOR_MAX_GAP_US restart the estimator
+ *
+ * @param estimator The estimator state. Clear running to restart the estimator
+ * @param depth_mm The depth reading in mm
+ * @param sample_time_us The time in us that the reading was acquired
+ */
+void depth_estimator_step(struct depth_estimator *estimator, int32_t depth_mm, uint64_t sample_time_us);
+
+/**
+ * @brief Converts the estimator state into depth and velocity with their variances
+ * The sample count is not known by the estimator, so it is left for the caller to fill
+ *
+ * @param estimator The estimator state
+ * @param estimate Output for the estimate
+ */
+void depth_estimator_get(const struct depth_estimator *estimator, struct depth_estimate *estimate);
+
+#endif
@@ -1,6 +1,14 @@
 #ifndef _ROS_H
 #define _ROS_H
 
+#include <rcl/rcl.h>
+
+/**
+ * @brief Returns the error from the calling function if fn fails
+ * Used by functions returning rcl_ret_t which leave handling the error to their caller
+ */
+#define RC_RETURN_CHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){return temp_rc;}}
+
 void ros_wait_for_connection(void);
 void ros_start(const char* namespace);
 void ros_spin_ms(long ms);
@@ -47,8 +47,11 @@ static void adc_poll_channel(struct adc_instance *inst) {
         hard_assert_if(ADC, inst->channel_to_read >= 8);
         inst->tx_buffer[0] = ADC_REG_CHANNEL_DATA(inst->channel_to_read);
 
-        async_i2c_enqueue(&inst->active_request, &inst->request_in_progress);
-
+        if (async_i2c_enqueue(&inst->active_request, &inst->request_in_progress) == ASYNC_I2C_ENQUEUE_QUEUE_FULL) {
+            // The bus is overloaded, so drop this reading and try again on the next poll
+            LOG_DEBUG("Skipping adc poll, i2c queue full");
+            inst->read_in_progress = false;
+        }
     } else {
         // No channels left to process
         inst->last_reading_time = get_absolute_time();
@@ -254,6 +257,9 @@ void adc_start(struct adc_instance *inst, const struct adc_configuration *config
     inst->active_request.failed_callback = &adc_init_failure;
     inst->active_request.next_req_on_success = NULL;
     inst->active_request.user_data = inst;
+    inst->active_request.priority = ASYNC_I2C_PRIORITY_NORMAL;
+    inst->active_request.repeated_start = true;
+    inst->active_request.speed = config->speed;
 
     // Send request to get ID
     inst->active_request.completed_callback = &adc_get_manufacturer_cb;
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include "hardware/dma.h"
 #include "hardware/i2c.h"
 #include "hardware/irq.h"
 #include "pico/binary_info.h"
@@ -19,6 +20,44 @@ static uint i2c_bus_timeout;
 
 #define I2C_REQ_QUEUE_SIZE 16
 
+/**
+ * @brief The maximum number of data commands for a single stage that can be sent via DMA
+ * Stages longer than this fall back to servicing the FIFO from interrupts
+ */
+#define I2C_DMA_MAX_STAGE_LENGTH 32
+
+/**
+ * @brief The TX FIFO level at or below which the DMA is requested to refill the FIFO
+ */
+#define I2C_DMA_TX_WATERMARK 8
+
+/**
+ * @brief The maximum number of SCL pulses clocked out to release a target holding SDA low
+ * A target can only be part way through a single byte and its ack, so 9 pulses is always enough
+ */
+#define I2C_RECOVERY_CLOCK_PULSES 9
+
+/**
+ * @brief Half of the SCL period used while clocking out a stuck target (100 kHz)
+ */
+#define I2C_RECOVERY_HALF_PERIOD_US 5
+
+/**
+ * @brief The time to wait for the controller to finish issuing a STOP after an abort before checking the bus lines
+ */
+#define I2C_RECOVERY_IDLE_WAIT_US 100
+
+/**
+ * @brief The baudrate for each speed profile. The default profile uses the baudrate passed to async_i2c_init
+ */
+static const uint async_i2c_speed_baudrates[ASYNC_I2C_NUM_SPEEDS] = {
+    [ASYNC_I2C_SPEED_DEFAULT] = 0,
+    [ASYNC_I2C_SPEED_STANDARD] = 100 * 1000,
+    [ASYNC_I2C_SPEED_FAST] = 400 * 1000,
+    [ASYNC_I2C_SPEED_FAST_PLUS] = 1000 * 1000,
+};
+static uint i2c_default_baudrate;
+
 static inline bool i2c_reserved_addr(uint8_t addr) {
     return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
 }
@@ -27,16 +66,23 @@ static inline bool i2c_reserved_addr(uint8_t addr) {
 struct pending_i2c_request {
     const struct async_i2c_request *pending_request;
     bool *in_progress;
-} pending_request_queue[I2C_REQ_QUEUE_SIZE];
+    uint32_t enqueue_time_us;
+};
 
-static int request_queue_next_entry = 0;
-static int request_queue_next_space = 0;
+/**
+ * @brief Ring buffer of pending requests for a single priority
+ */
+struct async_i2c_request_queue {
+    struct pending_i2c_request entries[I2C_REQ_QUEUE_SIZE];
+    int next_entry;
+    int next_space;
+};
 
 // ========================================
 // Bus Management Functions
 // ========================================
 
-static struct active_transfer_data {
+struct active_transfer_data {
     /* Request States
      * I2C_IDLE: No data is transmitting. The transfer needs to be started by enqueue to work
      *   - When setting to IDLE care must be taken to disable interrupts to prevent race conditions
@@ -57,82 +103,588 @@ static struct active_transfer_data {
     uint16_t receive_commands_queued;
     alarm_id_t timeout_alarm;
     bool alarm_active;
-} active_transfer = {.request_state = I2C_IDLE};
+    bool combined;              // If the read stage follows the write stage with a repeated start in the same transaction
+    bool using_dma;             // If the current stage is being paced by DMA rather than the FIFO interrupts
+    bool abort_requested;       // If the timeout has requested the controller to abort the request
+    uint32_t start_time_us;     // Time the request was started on the bus
+    uint16_t interrupt_count;   // Number of interrupts serviced for the request
+};
+
+/**
+ * @brief State for a single i2c controller
+ * Each hardware block has its own active transfer and request queue so both busses can run transactions concurrently
+ */
+static struct async_i2c_bus_state {
+    i2c_inst_t *i2c;
+    uint sda_pin;
+    uint scl_pin;
+    int target_address;     // The address currently programmed into the controller, or -1 if unknown
+    int speed;              // The speed profile currently programmed into the controller, or -1 if unknown
+    struct active_transfer_data active_transfer;
+
+    // Higher priority queues are always drained first, so a high priority request waits at most
+    // for the active request and any high priority requests queued ahead of it
+    struct async_i2c_request_queue request_queues[ASYNC_I2C_NUM_PRIORITIES];
+    struct async_i2c_queue_stats queue_stats[ASYNC_I2C_NUM_PRIORITIES];
+
+    struct async_i2c_irq_stats irq_stats;
+    struct async_i2c_speed_stats speed_stats[ASYNC_I2C_NUM_SPEEDS];
+    struct async_i2c_recovery_stats recovery_stats;
+    struct async_i2c_bus_stats bus_stats;
+
+#if ASYNC_I2C_USE_DMA
+    uint dma_tx_chan;
+    uint dma_rx_chan;
+    // Data commands are 32-bit writes since the command bits are above the data byte
+    uint32_t dma_cmd_buffer[I2C_DMA_MAX_STAGE_LENGTH];
+#endif
+} bus_states[NUM_I2CS] = {
+    {.target_address = -1, .speed = -1, .active_transfer = {.request_state = I2C_IDLE}},
+    {.target_address = -1, .speed = -1, .active_transfer = {.request_state = I2C_IDLE}},
+};
+
+static inline struct async_i2c_bus_state *async_i2c_get_bus(i2c_inst_t *i2c) {
+    return &bus_states[i2c_hw_index(i2c)];
+}
 
 #define has_irq_pending(i2c_inst, irq_name) (i2c_inst->hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_##irq_name##_BITS)
 
-static void async_i2c_start_transmit_stage(void) {
-    i2c_inst_t *i2c = active_transfer.request->i2c;
-    active_transfer.request_state = I2C_TRANSMITTING;
-        
-    // Set address
+/**
+ * @brief Computes the data command for the data command at the given index of the active stage
+ * While transmitting, the stage is made up of the tx bytes followed by the read commands if the request is combined.
+ * While receiving, the stage is only made up of the read commands
+ *
+ * @param bus The bus with the active request
+ * @param index The index of the command in the stage
+ * @return uint32_t The value to write to data_cmd
+ */
+static uint32_t async_i2c_get_data_cmd(struct async_i2c_bus_state *bus, uint16_t index) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    const struct async_i2c_request *request = active_transfer->request;
+    bool restart_on_next = bus->i2c->restart_on_next;
+
+    bool is_write_stage = (active_transfer->request_state == I2C_TRANSMITTING);
+    uint16_t read_offset = (is_write_stage ? request->bytes_to_send : 0);
+    uint16_t stage_length = read_offset + (!is_write_stage || active_transfer->combined ? request->bytes_to_receive : 0);
+
+    bool first = index == 0;
+    bool last = index + 1 == stage_length;
+    uint32_t flags = bool_to_bit(first && restart_on_next) << I2C_IC_DATA_CMD_RESTART_LSB |
+                     bool_to_bit(last && !request->nostop) << I2C_IC_DATA_CMD_STOP_LSB;
+
+    if (index < read_offset) {
+        return flags | request->tx_buffer[index];
+    } else {
+        // The first read of a combined transaction changes direction, so it must be sent with a repeated start
+        bool repeated_start = (index == read_offset && read_offset > 0);
+        return flags | bool_to_bit(repeated_start) << I2C_IC_DATA_CMD_RESTART_LSB | I2C_IC_DATA_CMD_CMD_BITS;
+    }
+}
+
+/**
+ * @brief Sets the target address of the controller
+ * The controller must be disabled to change the address, so this is skipped if the address is unchanged
+ *
+ * @param bus The bus to set the address for
+ * @param address The address to set
+ */
+static void async_i2c_set_target_address(struct async_i2c_bus_state *bus, uint8_t address) {
+    i2c_inst_t *i2c = bus->i2c;
+
+    if (bus->target_address == address) {
+        return;
+    }
+
     i2c->hw->enable = 0;
     while (i2c->hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS) {
         tight_loop_contents();
     }
-    i2c->hw->tar = active_transfer.request->address;
+    i2c->hw->tar = address;
     i2c->hw->enable = 1;
 
+    bus->target_address = address;
+}
+
+/**
+ * @brief Switches the controller to the given speed profile
+ * Changing the baudrate briefly disables the controller, so this is skipped if the speed is unchanged
+ *
+ * @param bus The bus to set the speed for
+ * @param speed The speed profile to set
+ */
+static void async_i2c_set_speed(struct async_i2c_bus_state *bus, enum async_i2c_speed speed) {
+    if (bus->speed == (int) speed) {
+        return;
+    }
+
+    uint baudrate = async_i2c_speed_baudrates[speed];
+    if (baudrate == 0) {
+        baudrate = i2c_default_baudrate;
+    }
+    bus->speed_stats[speed].baudrate = i2c_set_baudrate(bus->i2c, baudrate);
+    bus->speed = speed;
+}
+
+/**
+ * @brief Queues as many data commands for the active stage as space is available in the tx FIFO
+ * In a combined request the read commands are queued directly after the tx bytes
+ *
+ * @param bus The bus to fill the FIFO for
+ */
+static void async_i2c_fill_tx_fifo(struct async_i2c_bus_state *bus) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    i2c_inst_t *i2c = bus->i2c;
+    const struct async_i2c_request *request = active_transfer->request;
+
+    if (active_transfer->request_state == I2C_TRANSMITTING) {
+        while (i2c_get_write_available(i2c) && active_transfer->bytes_sent < request->bytes_to_send) {
+            i2c->hw->data_cmd = async_i2c_get_data_cmd(bus, active_transfer->bytes_sent);
+            active_transfer->bytes_sent++;
+        }
+
+        while (active_transfer->combined && i2c_get_write_available(i2c) && active_transfer->receive_commands_queued < request->bytes_to_receive) {
+            i2c->hw->data_cmd = async_i2c_get_data_cmd(bus, request->bytes_to_send + active_transfer->receive_commands_queued);
+            active_transfer->receive_commands_queued++;
+        }
+
+        bool read_commands_remaining = (active_transfer->combined && active_transfer->receive_commands_queued < request->bytes_to_receive);
+        if (active_transfer->bytes_sent < request->bytes_to_send || read_commands_remaining) {
+            // Enable the tx_empty interrupt if not all of the data or read commands are written
+            // The rx_full threshold may never be reached by the read commands already queued, so it can't be relied on to queue the rest
+            hw_set_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+        } else {
+            hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+        }
+    } else {
+        while (i2c_get_write_available(i2c) && active_transfer->receive_commands_queued < request->bytes_to_receive) {
+            i2c->hw->data_cmd = async_i2c_get_data_cmd(bus, active_transfer->receive_commands_queued);
+            active_transfer->receive_commands_queued++;
+        }
+    }
+
+    if (active_transfer->receive_commands_queued < request->bytes_to_receive && (active_transfer->request_state == I2C_RECEIVING || active_transfer->combined)) {
+        // Enable the rx_full interrupt to drain data and queue the remaining read commands
+        hw_set_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+    }
+}
+
+#if ASYNC_I2C_USE_DMA
+/**
+ * @brief Attempts to start the current stage using DMA
+ * The command buffer is filled with the data commands for the stage and the DMA is started.
+ * Since the FIFO interrupts are not used, the only interrupt for the stage is the STOP_DET on completion
+ *
+ * @param bus The bus to start the stage on
+ * @return true The stage was started with DMA
+ * @return false The stage could not use DMA and must be serviced by the FIFO interrupts
+ */
+static bool async_i2c_start_dma_stage(struct async_i2c_bus_state *bus) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    i2c_inst_t *i2c = bus->i2c;
+    const struct async_i2c_request *request = active_transfer->request;
+
+    bool is_write_stage = (active_transfer->request_state == I2C_TRANSMITTING);
+    uint16_t tx_length = (is_write_stage ? request->bytes_to_send : 0);
+    uint16_t rx_length = (!is_write_stage || active_transfer->combined ? request->bytes_to_receive : 0);
+    uint16_t length = tx_length + rx_length;
+
+    if (length > I2C_DMA_MAX_STAGE_LENGTH) {
+        active_transfer->using_dma = false;
+        return false;
+    }
+
+    for (uint16_t i = 0; i < length; i++) {
+        bus->dma_cmd_buffer[i] = async_i2c_get_data_cmd(bus, i);
+    }
+
+    if (rx_length > 0) {
+        dma_channel_config rx_config = dma_channel_get_default_config(bus->dma_rx_chan);
+        channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+        channel_config_set_read_increment(&rx_config, false);
+        channel_config_set_write_increment(&rx_config, true);
+        channel_config_set_dreq(&rx_config, i2c_get_dreq(i2c, false));
+        dma_channel_configure(bus->dma_rx_chan, &rx_config, request->rx_buffer, &i2c->hw->data_cmd, rx_length, true);
+    }
+    active_transfer->bytes_sent += tx_length;
+    active_transfer->receive_commands_queued = rx_length;
+
+    dma_channel_config tx_config = dma_channel_get_default_config(bus->dma_tx_chan);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(i2c, true));
+    dma_channel_configure(bus->dma_tx_chan, &tx_config, &i2c->hw->data_cmd, bus->dma_cmd_buffer, length, true);
+
+    active_transfer->using_dma = true;
+    return true;
+}
+
+/**
+ * @brief Stops any DMA transfers for the active stage
+ * This must be called before the TX abort is cleared, otherwise the DMA would continue to feed the FIFO
+ *
+ * @param bus The bus to stop DMA on
+ */
+static void async_i2c_stop_dma_stage(struct async_i2c_bus_state *bus) {
+    if (bus->active_transfer.using_dma) {
+        dma_channel_abort(bus->dma_tx_chan);
+        dma_channel_abort(bus->dma_rx_chan);
+        bus->active_transfer.using_dma = false;
+    }
+}
+
+/**
+ * @brief Finishes receiving data for a DMA stage after a STOP is detected
+ * The last bytes may still be in the FIFO waiting for the DMA to move them into the rx buffer
+ *
+ * @param bus The bus to finish the stage on
+ */
+static void async_i2c_finish_dma_stage(struct async_i2c_bus_state *bus) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    i2c_inst_t *i2c = bus->i2c;
+
+    if (active_transfer->request_state == I2C_RECEIVING || active_transfer->combined) {
+        while (dma_channel_is_busy(bus->dma_rx_chan) && i2c_get_read_available(i2c)) {
+            tight_loop_contents();
+        }
+        active_transfer->bytes_received = active_transfer->request->bytes_to_receive - dma_channel_hw_addr(bus->dma_rx_chan)->transfer_count;
+    }
+
+    // Release any channels which did not complete
+    async_i2c_stop_dma_stage(bus);
+}
+#endif
+
+/**
+ * @brief Records the time a request spent in the queue before being started on the bus
+ *
+ * @param bus The bus the request is starting on
+ * @param priority The priority of the request
+ * @param wait_us The time in microseconds that the request waited in the queue
+ */
+static void async_i2c_record_queue_wait(struct async_i2c_bus_state *bus, enum async_i2c_priority priority, uint32_t wait_us) {
+    struct async_i2c_queue_stats *stats = &bus->queue_stats[priority];
+
+    stats->requests++;
+    stats->last_wait_us = wait_us;
+    if (wait_us > stats->max_wait_us) {
+        stats->max_wait_us = wait_us;
+    }
+}
+
+/**
+ * @brief Removes the next request to run from the highest priority non-empty queue
+ *
+ * NOT INTERRUPT SAFE (Must be called from the bus irq or with interrupts disabled)
+ *
+ * @param bus The bus to dequeue from
+ * @return struct pending_i2c_request* The next request or NULL if all queues are empty
+ */
+static struct pending_i2c_request *async_i2c_dequeue(struct async_i2c_bus_state *bus) {
+    for (int priority = ASYNC_I2C_NUM_PRIORITIES - 1; priority >= 0; priority--) {
+        struct async_i2c_request_queue *queue = &bus->request_queues[priority];
+        if (queue->next_entry != queue->next_space) {
+            struct pending_i2c_request *next = &queue->entries[queue->next_entry];
+
+            // Increment ring buffer
+            queue->next_entry = (queue->next_entry + 1) % I2C_REQ_QUEUE_SIZE;
+
+            async_i2c_record_queue_wait(bus, priority, time_us_32() - next->enqueue_time_us);
+            return next;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Finds the statistics entry for an address, allocating a new entry if the address hasn't been seen before
+ *
+ * @param bus The bus to search
+ * @param address The address to find
+ * @return struct async_i2c_address_stats* The entry for the address or NULL if there are no free entries
+ */
+static struct async_i2c_address_stats *async_i2c_get_address_stats(struct async_i2c_bus_state *bus, uint8_t address) {
+    struct async_i2c_bus_stats *bus_stats = &bus->bus_stats;
+
+    for (int i = 0; i < bus_stats->num_addresses; i++) {
+        if (bus_stats->addresses[i].address == address) {
+            return &bus_stats->addresses[i];
+        }
+    }
+
+    if (bus_stats->num_addresses < ASYNC_I2C_MAX_TRACKED_ADDRESSES) {
+        struct async_i2c_address_stats *entry = &bus_stats->addresses[bus_stats->num_addresses++];
+        entry->address = address;
+        return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Records the usage statistics for the request that just finished on the bus
+ *
+ * @param bus The bus the request finished on
+ * @param abort_reason The abort reason if the request failed, or 0 if the request was successful
+ */
+static void async_i2c_record_request_stats(struct async_i2c_bus_state *bus, uint32_t abort_reason) {
+    uint16_t interrupts = bus->active_transfer.interrupt_count;
+
+    bus->irq_stats.transactions++;
+    bus->irq_stats.last_request_interrupts = interrupts;
+    if (interrupts > bus->irq_stats.max_request_interrupts) {
+        bus->irq_stats.max_request_interrupts = interrupts;
+    }
+
+    struct async_i2c_speed_stats *speed_stats = &bus->speed_stats[bus->active_transfer.request->speed];
+    uint32_t transaction_us = time_us_32() - bus->active_transfer.start_time_us;
+
+    speed_stats->requests++;
+    speed_stats->last_transaction_us = transaction_us;
+    if (transaction_us > speed_stats->max_transaction_us) {
+        speed_stats->max_transaction_us = transaction_us;
+    }
+
+    struct async_i2c_bus_stats *bus_stats = &bus->bus_stats;
+    bus_stats->busy_time_us += transaction_us;
+    bus_stats->transactions++;
+    if (abort_reason) {
+        bus_stats->failures++;
+        for (int i = 0; i < ASYNC_I2C_NUM_ABORT_SOURCES; i++) {
+            if (abort_reason & (1u << i)) {
+                bus_stats->abort_counts[i]++;
+            }
+        }
+    }
+
+    struct async_i2c_address_stats *address_stats = async_i2c_get_address_stats(bus, bus->active_transfer.request->address);
+    if (address_stats) {
+        int bucket = 0;
+        while (bucket < ASYNC_I2C_LATENCY_BUCKETS - 1 && transaction_us >= ((uint32_t) ASYNC_I2C_LATENCY_BUCKET_BASE_US << bucket)) {
+            bucket++;
+        }
+
+        address_stats->transactions++;
+        address_stats->latency_histogram[bucket]++;
+        if (abort_reason) {
+            address_stats->failures++;
+        }
+    } else {
+        bus_stats->untracked_transactions++;
+    }
+}
+
+static void async_i2c_start_transmit_stage(struct async_i2c_bus_state *bus) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    __unused i2c_inst_t *i2c = bus->i2c;
+    active_transfer->request_state = I2C_TRANSMITTING;
+
+    async_i2c_set_target_address(bus, active_transfer->request->address);
+
     hard_assert_if(ASYNC_I2C, i2c->hw->rxflr != 0);
     hard_assert_if(ASYNC_I2C, i2c->hw->txflr != 0);
 
+#if ASYNC_I2C_USE_DMA
+    if (async_i2c_start_dma_stage(bus)) {
+        return;
+    }
+#endif
+
     // Send command
-    while (i2c_get_write_available(i2c) && active_transfer.bytes_sent < active_transfer.request->bytes_to_send) {
-        bool first = active_transfer.bytes_sent == 0;
-        bool last = active_transfer.bytes_sent + 1 == active_transfer.request->bytes_to_send;
+    async_i2c_fill_tx_fifo(bus);
+}
 
-        i2c->hw->data_cmd =
-                bool_to_bit(first && i2c->restart_on_next) << I2C_IC_DATA_CMD_RESTART_LSB |
-                bool_to_bit(last && !active_transfer.request->nostop) << I2C_IC_DATA_CMD_STOP_LSB |
-                active_transfer.request->tx_buffer[active_transfer.bytes_sent];
+static void async_i2c_start_receive_stage(struct async_i2c_bus_state *bus) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    __unused i2c_inst_t *i2c = bus->i2c;
+    active_transfer->request_state = I2C_RECEIVING;
 
-        active_transfer.bytes_sent++;
-    }
+    async_i2c_set_target_address(bus, active_transfer->request->address);
+
+    hard_assert_if(ASYNC_I2C, i2c->hw->rxflr != 0);
+    hard_assert_if(ASYNC_I2C, i2c->hw->txflr != 0);
 
-    if (active_transfer.bytes_sent < active_transfer.request->bytes_to_send) {
-        // Enable the tx_empty interrupt if not all of the data is written 
-        hw_set_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+#if ASYNC_I2C_USE_DMA
+    if (async_i2c_start_dma_stage(bus)) {
+        return;
     }
+#endif
+
+    async_i2c_fill_tx_fifo(bus);
+}
+
+// ========================================
+// Bus Recovery
+// ========================================
+
+/**
+ * @brief Configures the i2c controller registers used by the driver
+ * Must be called after every reset of the controller, as the configuration is lost
+ *
+ * @param i2c The i2c controller to configure
+ */
+static void async_i2c_configure_interrupt_hw(i2c_inst_t *i2c) {
+    i2c->hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | 
+                          I2C_IC_INTR_MASK_M_TX_OVER_BITS | I2C_IC_INTR_MASK_M_RX_OVER_BITS |
+                          I2C_IC_INTR_MASK_M_RX_UNDER_BITS;
+
+    i2c->hw->rx_tl = 10;
+    i2c->hw->tx_tl = 6;
+
+#if ASYNC_I2C_USE_DMA
+    // Request data as soon as a single byte is in the rx FIFO so the last byte is available at STOP_DET
+    i2c->hw->dma_tdlr = I2C_DMA_TX_WATERMARK;
+    i2c->hw->dma_rdlr = 0;
+    i2c->hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+#endif
 }
 
-static void async_i2c_start_receive_stage(void) {
-    i2c_inst_t *i2c = active_transfer.request->i2c;
-    active_transfer.request_state = I2C_RECEIVING;
+/**
+ * @brief Initializes the controller and pins for the bus
+ * The controller is left at the default baudrate with no target address, so both are set again on the next request
+ *
+ * @param bus The bus to initialize
+ */
+static void async_i2c_setup_bus_hw(struct async_i2c_bus_state *bus) {
+    i2c_init(bus->i2c, i2c_default_baudrate);
+    gpio_set_function(bus->sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(bus->scl_pin, GPIO_FUNC_I2C);
+    gpio_pull_up(bus->sda_pin);
+    gpio_pull_up(bus->scl_pin);
+    async_i2c_configure_interrupt_hw(bus->i2c);
+
+    bus->target_address = -1;
+    bus->speed = -1;
+}
 
-    i2c->hw->enable = 0;
-    while (i2c->hw->enable_status & I2C_IC_ENABLE_STATUS_IC_EN_BITS) {
+/**
+ * @brief Checks if the bus lines are being held after the controller has finished with the bus
+ * Waits briefly for the controller to finish issuing any STOP from the abort
+ *
+ * @param bus The bus to check
+ * @return true The controller or a target is still holding the bus
+ * @return false The bus is idle
+ */
+static bool async_i2c_bus_stuck(struct async_i2c_bus_state *bus) {
+    uint32_t start_time = time_us_32();
+    while ((bus->i2c->hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS) && time_us_32() - start_time < I2C_RECOVERY_IDLE_WAIT_US) {
         tight_loop_contents();
     }
-    i2c->hw->tar = active_transfer.request->address;
-    i2c->hw->enable = 1;
 
-    hard_assert_if(ASYNC_I2C, i2c->hw->rxflr != 0);
-    hard_assert_if(ASYNC_I2C, i2c->hw->txflr != 0);
-    
-    while (i2c_get_write_available(i2c) && active_transfer.receive_commands_queued < active_transfer.request->bytes_to_receive) {
-        bool first = active_transfer.receive_commands_queued == 0;
-        bool last = active_transfer.receive_commands_queued + 1 == active_transfer.request->bytes_to_receive;
+    return (bus->i2c->hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS) || !gpio_get(bus->sda_pin) || !gpio_get(bus->scl_pin);
+}
 
-        i2c->hw->data_cmd =
-                bool_to_bit(first && i2c->restart_on_next) << I2C_IC_DATA_CMD_RESTART_LSB |
-                bool_to_bit(last && !active_transfer.request->nostop) << I2C_IC_DATA_CMD_STOP_LSB |
-                I2C_IC_DATA_CMD_CMD_BITS; // -> 1 for read
+/**
+ * @brief Recovers a bus that is held by a wedged target
+ * SCL is clocked on GPIO until the target releases SDA, a STOP is generated, and the controller is reinitialized.
+ * Any queued requests are left in the queue, so the caller must start the next request afterwards
+ *
+ * NOT INTERRUPT SAFE (Must be called from the bus irq or with the bus irq disabled)
+ *
+ * @param bus The bus to recover
+ */
+static void async_i2c_recover_bus(struct async_i2c_bus_state *bus) {
+    uint32_t start_time = time_us_32();
+    uint sda = bus->sda_pin;
+    uint scl = bus->scl_pin;
+
+#if ASYNC_I2C_USE_DMA
+    async_i2c_stop_dma_stage(bus);
+#endif
+    i2c_deinit(bus->i2c);
+
+    // The lines are driven open drain by switching between a low output and an input, with the pull-ups releasing the line
+    gpio_init(sda);
+    gpio_init(scl);
+    for (int i = 0; i < I2C_RECOVERY_CLOCK_PULSES && !gpio_get(sda); i++) {
+        gpio_set_dir(scl, GPIO_OUT);
+        busy_wait_us_32(I2C_RECOVERY_HALF_PERIOD_US);
+        gpio_set_dir(scl, GPIO_IN);
+        busy_wait_us_32(I2C_RECOVERY_HALF_PERIOD_US);
+    }
 
-        active_transfer.receive_commands_queued++;
+    // Generate a STOP so all targets return to idle
+    gpio_set_dir(scl, GPIO_OUT);
+    gpio_set_dir(sda, GPIO_OUT);
+    busy_wait_us_32(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_dir(scl, GPIO_IN);
+    busy_wait_us_32(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_dir(sda, GPIO_IN);
+    busy_wait_us_32(I2C_RECOVERY_HALF_PERIOD_US);
+
+    bool recovered = gpio_get(sda) && gpio_get(scl);
+    async_i2c_setup_bus_hw(bus);
+
+    uint32_t recovery_us = time_us_32() - start_time;
+    bus->bus_stats.busy_time_us += recovery_us;
+
+    struct async_i2c_recovery_stats *stats = &bus->recovery_stats;
+    stats->recoveries++;
+    stats->last_recovery_us = recovery_us;
+    if (recovery_us > stats->max_recovery_us) {
+        stats->max_recovery_us = recovery_us;
     }
 
-    if (active_transfer.receive_commands_queued < active_transfer.request->bytes_to_receive) {
-        // Enable the tx_empty interrupt if not all of the data is written 
-        hw_set_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+    if (recovered) {
+        LOG_WARN("Recovered i2c%d in %lu us", i2c_hw_index(bus->i2c), recovery_us);
+    } else {
+        stats->failed_recoveries++;
+        LOG_ERROR("Failed to release i2c%d lines during recovery", i2c_hw_index(bus->i2c));
+        safety_raise_fault(FAULT_ASYNC_I2C_ERROR);
     }
 }
 
-static int64_t async_i2c_timeout_callback(__unused alarm_id_t id, __unused void *user_data) {
-    active_transfer.alarm_active = false;
-    i2c_inst_t *i2c = active_transfer.request->i2c;
+/**
+ * @brief Marks the active request as failed and notifies the caller
+ *
+ * @param bus The bus with the active request
+ * @param abort_reason The abort reason passed to the failed callback
+ */
+static void async_i2c_fail_active_request(struct async_i2c_bus_state *bus, uint32_t abort_reason) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+
+    active_transfer->request_state = I2C_DONE;
+    async_i2c_record_request_stats(bus, abort_reason);
+    *active_transfer->in_progress = false;
+    if (active_transfer->request->failed_callback) {
+        active_transfer->request->failed_callback(active_transfer->request, abort_reason);
+    }
+}
+
+/**
+ * @brief Starts the next queued request, or releases the bus if the queue is empty
+ *
+ * NOT INTERRUPT SAFE (Must be called from the bus irq or with the bus irq disabled)
+ *
+ * @param bus The bus to start the next request on
+ */
+static void async_i2c_start_next_request(struct async_i2c_bus_state *bus);
+
+static int64_t async_i2c_timeout_callback(__unused alarm_id_t id, void *user_data) {
+    struct async_i2c_bus_state *bus = (struct async_i2c_bus_state *)user_data;
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+    i2c_inst_t *i2c = bus->i2c;
+
+    if (!active_transfer->abort_requested) {
+        LOG_DEBUG("Timeout Called (0x%p)", active_transfer->request);
+        active_transfer->abort_requested = true;
+        hw_set_bits(&i2c->hw->enable, I2C_IC_ENABLE_ABORT_BITS);
+
+        // Give the controller another timeout period to abort, after which the bus is assumed to be wedged
+        return ((int64_t) i2c_bus_timeout) * 1000;
+    }
+
+    LOG_WARN("Abort did not complete (0x%p), recovering bus", active_transfer->request);
+    active_transfer->alarm_active = false;
+
+    uint irq_num = I2C0_IRQ + i2c_hw_index(i2c);
+    irq_set_enabled(irq_num, false);
+    async_i2c_recover_bus(bus);
+    async_i2c_fail_active_request(bus, I2C_IC_TX_ABRT_SOURCE_ABRT_USER_ABRT_BITS);
+    async_i2c_start_next_request(bus);
+    irq_set_enabled(irq_num, true);
 
-    LOG_DEBUG("Timeout Called (0x%p)", active_transfer.request);
-    hw_set_bits(&i2c->hw->enable, I2C_IC_ENABLE_ABORT_BITS);
     return 0;
 }
 
@@ -143,30 +695,37 @@ static int64_t async_i2c_timeout_callback(__unused alarm_id_t id, __unused void
  * 
  * INTERRUPT SAFE* (If the code owns the bus)
  * 
+ * @param bus The bus the request is to be performed on
  * @param request Request to start
  * @param in_progress The pointer to the in_progress boolean
  */
-int total_allocated_alarm_count = 0;
-static void async_i2c_start_request_internal(const struct async_i2c_request *request, bool *in_progress) {
+static void async_i2c_start_request_internal(struct async_i2c_bus_state *bus, const struct async_i2c_request *request, bool *in_progress) {
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
     LOG_DEBUG("Starting request 0x%p", request);
-    active_transfer.request = request;
-    active_transfer.in_progress = in_progress;
-    active_transfer.bytes_received = 0;
-    active_transfer.receive_commands_queued = 0;
-    active_transfer.bytes_sent = 0;
-
-    valid_params_if(ASYNC_I2C, active_transfer.request_state == I2C_PENDING || active_transfer.request_state == I2C_DONE);
-    hard_assert_if(ASYNC_I2C, active_transfer.alarm_active);
-    total_allocated_alarm_count++;
-    alarm_id_t alarm_id = add_alarm_in_ms(i2c_bus_timeout, &async_i2c_timeout_callback, NULL, true);
+    active_transfer->request = request;
+    active_transfer->in_progress = in_progress;
+    active_transfer->bytes_received = 0;
+    active_transfer->receive_commands_queued = 0;
+    active_transfer->bytes_sent = 0;
+    active_transfer->combined = (request->repeated_start && request->bytes_to_send > 0 && request->bytes_to_receive > 0);
+    active_transfer->using_dma = false;
+    active_transfer->interrupt_count = 0;
+    active_transfer->abort_requested = false;
+    active_transfer->start_time_us = time_us_32();
+
+    valid_params_if(ASYNC_I2C, active_transfer->request_state == I2C_PENDING || active_transfer->request_state == I2C_DONE);
+    hard_assert_if(ASYNC_I2C, active_transfer->alarm_active);
+    alarm_id_t alarm_id = add_alarm_in_ms(i2c_bus_timeout, &async_i2c_timeout_callback, bus, true);
     hard_assert(alarm_id > 0);
-    active_transfer.timeout_alarm = alarm_id;
-    active_transfer.alarm_active = true;
+    active_transfer->timeout_alarm = alarm_id;
+    active_transfer->alarm_active = true;
+
+    async_i2c_set_speed(bus, request->speed);
 
     if (request->bytes_to_send > 0) {
-        async_i2c_start_transmit_stage();
+        async_i2c_start_transmit_stage(bus);
     } else if (request->bytes_to_receive > 0) {
-        async_i2c_start_receive_stage();
+        async_i2c_start_receive_stage(bus);
     } else {
         *in_progress = false;
     }
@@ -178,13 +737,18 @@ static void async_i2c_start_request_internal(const struct async_i2c_request *req
  * @param i2c The i2c inst which caused the interrupt
  */
 static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+    struct active_transfer_data *active_transfer = &bus->active_transfer;
+
     if (!(i2c->hw->raw_intr_stat & i2c->hw->intr_mask)) {
         return;  // In the event the IRQ went away, ignore it
         // Could happen if the full/empty irq tripped during fill/emptying
     }
-    LOG_DEBUG("Interrupt callback on %s for 0x%p, active interrupts 0x%x", (i2c == i2c0 ? "i2c0" : (i2c == i2c1 ? "i2c1" : "Unknown")), active_transfer.request, i2c->hw->raw_intr_stat & i2c->hw->intr_mask);
+    active_transfer->interrupt_count++;
+    bus->irq_stats.interrupts++;
+    LOG_DEBUG("Interrupt callback on %s for 0x%p, active interrupts 0x%x", (i2c == i2c0 ? "i2c0" : (i2c == i2c1 ? "i2c1" : "Unknown")), active_transfer->request, i2c->hw->raw_intr_stat & i2c->hw->intr_mask);
 
-    hard_assert_if(ASYNC_I2C, i2c != active_transfer.request->i2c);
+    hard_assert_if(ASYNC_I2C, i2c != active_transfer->request->i2c);
 
     // Handle software issues first
     if (has_irq_pending(i2c, TX_OVER)) {
@@ -206,18 +770,22 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
     if (has_irq_pending(i2c, TX_ABRT)) {
         transfer_aborted = true;
 
-        if (active_transfer.alarm_active) {
-            cancel_alarm(active_transfer.timeout_alarm);
-            active_transfer.alarm_active = false;
+        if (active_transfer->alarm_active) {
+            cancel_alarm(active_transfer->timeout_alarm);
+            active_transfer->alarm_active = false;
         }
 
+#if ASYNC_I2C_USE_DMA
+        // The FIFO is held flushed until the abort is cleared, so the DMA must be stopped first
+        async_i2c_stop_dma_stage(bus);
+#endif
+
         // Transmit abort
         uint32_t abort_reason = i2c->hw->tx_abrt_source;
         i2c->hw->clr_tx_abrt;
 
         hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_FULL_BITS);
-        i2c->restart_on_next = active_transfer.request->nostop;
-        active_transfer.request_state = I2C_DONE;
+        i2c->restart_on_next = active_transfer->request->nostop;
 
         // These are the tx aborts that are possible failures from the bus rather than internal
         const uint32_t valid_bus_faults = I2C_IC_TX_ABRT_SOURCE_ABRT_USER_ABRT_BITS | 
@@ -227,78 +795,57 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
                                           I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_BITS | 
                                           I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_BITS;
 
-        if (abort_reason & ~(I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS | valid_bus_faults)) {
+        if (abort_reason & ~(I2C_IC_TX_ABRT_SOURCE_TX_FLUSH_CNT_BITS | I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS | valid_bus_faults)) {
             LOG_ERROR("Unexpected TX Abort: %lu", abort_reason);
             safety_raise_fault(FAULT_ASYNC_I2C_ERROR);
         }
-        
-        *active_transfer.in_progress = false;
-        if (active_transfer.request->failed_callback) {
-            active_transfer.request->failed_callback(active_transfer.request, abort_reason);
+
+        // A timed out transfer or lost arbitration can be caused by a target holding the bus
+        // Recover the bus now so the queued requests don't also fail
+        const uint32_t possibly_stuck_faults = I2C_IC_TX_ABRT_SOURCE_ABRT_USER_ABRT_BITS | I2C_IC_TX_ABRT_SOURCE_ARB_LOST_BITS;
+        if ((abort_reason & possibly_stuck_faults) && async_i2c_bus_stuck(bus)) {
+            async_i2c_recover_bus(bus);
         }
+
+        async_i2c_fail_active_request(bus, abort_reason);
     }
 
     // Handle normal states
-    if (!transfer_aborted && has_irq_pending(i2c, TX_EMPTY)) {
+    if (!transfer_aborted && has_irq_pending(i2c, TX_EMPTY) && (i2c->hw->intr_mask & I2C_IC_INTR_MASK_M_TX_EMPTY_BITS)) {
         // Transmit buffer needs to be filled (cleared by hw)
-
-        while (i2c_get_write_available(i2c) && active_transfer.bytes_sent < active_transfer.request->bytes_to_send) {
-            bool first = active_transfer.bytes_sent == 0;
-            bool last = active_transfer.bytes_sent + 1 == active_transfer.request->bytes_to_send;
-
-            i2c->hw->data_cmd =
-                    bool_to_bit(first && i2c->restart_on_next) << I2C_IC_DATA_CMD_RESTART_LSB |
-                    bool_to_bit(last && !active_transfer.request->nostop) << I2C_IC_DATA_CMD_STOP_LSB |
-                    active_transfer.request->tx_buffer[active_transfer.bytes_sent];
-
-            active_transfer.bytes_sent++;
-        }
-
-        if (active_transfer.bytes_sent == active_transfer.request->bytes_to_send) {
-            hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
-        }
-        
+        async_i2c_fill_tx_fifo(bus);
     }
     if (!transfer_aborted && has_irq_pending(i2c, RX_FULL)) {
         // Receive buffer needs to be read in (cleared by hw)
         while (i2c_get_read_available(i2c)) {
-            assert(active_transfer.bytes_received < active_transfer.request->bytes_to_receive);
-
-            active_transfer.request->rx_buffer[active_transfer.bytes_received] = (uint8_t) i2c->hw->data_cmd;
-            active_transfer.bytes_received++;
-        }
-
-        while (i2c_get_write_available(i2c) && active_transfer.receive_commands_queued < active_transfer.request->bytes_to_receive) {
-            bool first = active_transfer.receive_commands_queued == 0;
-            bool last = active_transfer.receive_commands_queued + 1 == active_transfer.request->bytes_to_receive;
-
-            i2c->hw->data_cmd =
-                    bool_to_bit(first && i2c->restart_on_next) << I2C_IC_DATA_CMD_RESTART_LSB |
-                    bool_to_bit(last && !active_transfer.request->nostop) << I2C_IC_DATA_CMD_STOP_LSB |
-                    I2C_IC_DATA_CMD_CMD_BITS; // -> 1 for read
-
-            active_transfer.receive_commands_queued++;
-        }
+            assert(active_transfer->bytes_received < active_transfer->request->bytes_to_receive);
 
-        if (active_transfer.receive_commands_queued < active_transfer.request->bytes_to_receive) {
-            // Enable the tx_empty interrupt if not all of the data is written 
-            hw_set_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+            active_transfer->request->rx_buffer[active_transfer->bytes_received] = (uint8_t) i2c->hw->data_cmd;
+            active_transfer->bytes_received++;
         }
 
+        hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_RX_FULL_BITS);
+        async_i2c_fill_tx_fifo(bus);
     }
     if (has_irq_pending(i2c, STOP_DET)) {
         LOG_DEBUG("Stop Detected");
         // Cleanup previous request
         i2c->hw->clr_stop_det;
         hw_clear_bits(&i2c->hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS | I2C_IC_INTR_MASK_M_RX_FULL_BITS);
-        i2c->restart_on_next = active_transfer.request->nostop;
+        i2c->restart_on_next = active_transfer->request->nostop;
+
+#if ASYNC_I2C_USE_DMA
+        if (active_transfer->using_dma) {
+            async_i2c_finish_dma_stage(bus);
+        }
+#endif
 
         // Handle any remaining data in the receive buffer after stop
         while (i2c_get_read_available(i2c)) {
-            assert(active_transfer.bytes_received < active_transfer.request->bytes_to_receive);
+            assert(active_transfer->bytes_received < active_transfer->request->bytes_to_receive);
 
-            active_transfer.request->rx_buffer[active_transfer.bytes_received] = (uint8_t) i2c->hw->data_cmd;
-            active_transfer.bytes_received++;
+            active_transfer->request->rx_buffer[active_transfer->bytes_received] = (uint8_t) i2c->hw->data_cmd;
+            active_transfer->bytes_received++;
         }
 
         // Only do processing on start bit if the data was properly received
@@ -306,30 +853,34 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
         if (transfer_aborted) {
             LOG_DEBUG("Transfer aborted");
             // Do nothing on aborted transfer
-        } else if (active_transfer.request_state == I2C_TRANSMITTING && active_transfer.bytes_sent == active_transfer.request->bytes_to_send && active_transfer.request->bytes_to_receive > 0) {
+        } else if (active_transfer->request_state == I2C_TRANSMITTING && !active_transfer->combined && active_transfer->bytes_sent == active_transfer->request->bytes_to_send && active_transfer->request->bytes_to_receive > 0) {
             LOG_DEBUG("Starting receive stage");
-            async_i2c_start_receive_stage();
-        } else if (active_transfer.bytes_sent == active_transfer.request->bytes_to_send && active_transfer.bytes_received == active_transfer.request->bytes_to_receive) {
-            LOG_DEBUG("Finalizing Request 0x%p...", active_transfer.request);
-            hard_assert_if(ASYNC_I2C, active_transfer.request_state != I2C_TRANSMITTING && active_transfer.request_state != I2C_RECEIVING);
-
-            if (active_transfer.alarm_active) {
-                cancel_alarm(active_transfer.timeout_alarm);
-                active_transfer.alarm_active = false;
+            async_i2c_start_receive_stage(bus);
+        } else if (active_transfer->bytes_sent == active_transfer->request->bytes_to_send && active_transfer->bytes_received == active_transfer->request->bytes_to_receive) {
+            LOG_DEBUG("Finalizing Request 0x%p...", active_transfer->request);
+            hard_assert_if(ASYNC_I2C, active_transfer->request_state != I2C_TRANSMITTING && active_transfer->request_state != I2C_RECEIVING);
+
+            if (active_transfer->alarm_active) {
+                cancel_alarm(active_transfer->timeout_alarm);
+                active_transfer->alarm_active = false;
             }
 
             // Do processing for final bit
-            hard_assert_if(ASYNC_I2C, active_transfer.receive_commands_queued != active_transfer.request->bytes_to_receive);
+            hard_assert_if(ASYNC_I2C, active_transfer->receive_commands_queued != active_transfer->request->bytes_to_receive);
+
+            async_i2c_record_request_stats(bus, 0);
+            active_transfer->request_state = I2C_DONE;
 
-            active_transfer.request_state = I2C_DONE;
-            if (active_transfer.request->next_req_on_success) {
-                async_i2c_start_request_internal(active_transfer.request->next_req_on_success, active_transfer.in_progress);
+            // Starting the next request replaces the active request, so save the request for the callback
+            const struct async_i2c_request *finished_request = active_transfer->request;
+            if (finished_request->next_req_on_success) {
+                async_i2c_start_request_internal(bus, finished_request->next_req_on_success, active_transfer->in_progress);
             } else {
-                *active_transfer.in_progress = false;
+                *active_transfer->in_progress = false;
             }
 
-            if (active_transfer.request->completed_callback) {
-                active_transfer.request->completed_callback(active_transfer.request);
+            if (finished_request->completed_callback) {
+                finished_request->completed_callback(finished_request);
             }
         } else {
             LOG_DEBUG("Unexpected STOP");
@@ -337,18 +888,19 @@ static void async_i2c_common_irq_handler(i2c_inst_t *i2c) {
     }
 
     // Handle transaction complete
-    if (active_transfer.request_state == I2C_DONE) {
-        if (request_queue_next_entry != request_queue_next_space) {
-            // Get next piece of data in the queue
-            async_i2c_start_request_internal(pending_request_queue[request_queue_next_entry].pending_request,
-                                            pending_request_queue[request_queue_next_entry].in_progress);
+    if (active_transfer->request_state == I2C_DONE) {
+        async_i2c_start_next_request(bus);
+    }
+}
 
-            // Increment ring buffer
-            request_queue_next_entry = (request_queue_next_entry + 1) % I2C_REQ_QUEUE_SIZE;
-        } else {
-            LOG_DEBUG("Transferring to idle state (0x%p)", active_transfer.request);
-            active_transfer.request_state = I2C_IDLE;
-        }
+static void async_i2c_start_next_request(struct async_i2c_bus_state *bus) {
+    // Get next piece of data in the queue
+    struct pending_i2c_request *next = async_i2c_dequeue(bus);
+    if (next) {
+        async_i2c_start_request_internal(bus, next->pending_request, next->in_progress);
+    } else {
+        LOG_DEBUG("Transferring to idle state (0x%p)", bus->active_transfer.request);
+        bus->active_transfer.request_state = I2C_IDLE;
     }
 }
 
@@ -369,6 +921,10 @@ __unused static bool async_i2c_validate_request(const struct async_i2c_request *
         return false;
     }
 
+    if (request->priority >= ASYNC_I2C_NUM_PRIORITIES || request->speed >= ASYNC_I2C_NUM_SPEEDS) {
+        return false;
+    }
+
     bool has_transfer = false;
     if (request->bytes_to_send > 0) {
         if (request->tx_buffer != NULL) {
@@ -393,6 +949,11 @@ __unused static bool async_i2c_validate_request(const struct async_i2c_request *
 
     // Recursively check sub-requests
     if (request->next_req_on_success) {
+        // Chained requests are run from the active transfer of a single bus
+        if (request->next_req_on_success->i2c != request->i2c) {
+            return false;
+        }
+
         if (!async_i2c_validate_request(request->next_req_on_success)) {
             return false;
         }
@@ -402,57 +963,304 @@ __unused static bool async_i2c_validate_request(const struct async_i2c_request *
 }
 
 /**
- * @brief Returns if there is space in the async i2c queue
+ * @brief Returns if the async i2c queue is full
  * 
  * INITIALIZATION REQUIRED
  * INTERRUPT SAFE* (This might return true but if another command queues after queue still might not be safe to call)
  * 
- * @return true  Space is available in the queue
- * @return false No space is available in the queue for new requests
+ * @param queue The queue to check
+ * @return true  No space is available in the queue for new requests
+ * @return false Space is available in the queue
+ */
+static bool async_i2c_queue_full(struct async_i2c_request_queue *queue) {
+    return ((queue->next_space + 1) % I2C_REQ_QUEUE_SIZE) == queue->next_entry;
+}
+
+/**
+ * @brief Returns if the request is still waiting in one of the bus queues
+ * A request is only considered the same if it also uses the same in_progress pointer
+ *
+ * NOT INTERRUPT SAFE (Must be called with interrupts disabled)
+ *
+ * @param bus The bus to search
+ * @param request The request to search for
+ * @param in_progress The in_progress pointer the request was queued with
+ * @return true The request is queued and its buffers have not been read yet
+ * @return false The request is not queued
  */
-static bool async_i2c_queue_full(void) {
-    return ((request_queue_next_space + 1) % I2C_REQ_QUEUE_SIZE) == request_queue_next_entry;
+static bool async_i2c_request_queued(struct async_i2c_bus_state *bus, const struct async_i2c_request *request, bool *in_progress) {
+    for (int priority = 0; priority < ASYNC_I2C_NUM_PRIORITIES; priority++) {
+        struct async_i2c_request_queue *queue = &bus->request_queues[priority];
+        for (int i = queue->next_entry; i != queue->next_space; i = (i + 1) % I2C_REQ_QUEUE_SIZE) {
+            if (queue->entries[i].pending_request == request && queue->entries[i].in_progress == in_progress) {
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
-void async_i2c_enqueue(const struct async_i2c_request *request, bool *in_progress) {
+enum async_i2c_enqueue_result async_i2c_enqueue(const struct async_i2c_request *request, bool *in_progress) {
     if (!async_i2c_initialized) {
         panic("Aync I2C not initialized");
     }
     
     valid_params_if(ASYNC_I2C, async_i2c_validate_request(request));
-    invalid_params_if(ASYNC_I2C, *in_progress);
+
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(request->i2c);
+    struct async_i2c_request_queue *queue = &bus->request_queues[request->priority];
 
     // Disable interrupts during operation to prevent corruption
     uint32_t prev_interrupt = save_and_disable_interrupts();
 
-    if (async_i2c_queue_full()) {
+    if (*in_progress && async_i2c_request_queued(bus, request, in_progress)) {
+        bus->queue_stats[request->priority].coalesced++;
         restore_interrupts(prev_interrupt);
-        LOG_ERROR("Buffer overflow enqueuing i2c commands");
-        safety_raise_fault(FAULT_ASYNC_I2C_ERROR);
-        return;
+        return ASYNC_I2C_ENQUEUE_COALESCED;
+    }
+    // The active request may be a later request in the chain, but it still shares in_progress
+    // Its data may already be on the wire, so it can't be merged with
+    if (*in_progress && bus->active_transfer.request_state != I2C_IDLE && bus->active_transfer.in_progress == in_progress) {
+        restore_interrupts(prev_interrupt);
+        return ASYNC_I2C_ENQUEUE_IN_FLIGHT;
+    }
+    invalid_params_if(ASYNC_I2C, *in_progress);
+
+    if (async_i2c_queue_full(queue)) {
+        // Dropping the request lets the caller back off rather than faulting the board when the bus is overloaded
+        bus->queue_stats[request->priority].rejected++;
+        restore_interrupts(prev_interrupt);
+        LOG_DEBUG("Queue full, dropping i2c request 0x%p", request);
+        return ASYNC_I2C_ENQUEUE_QUEUE_FULL;
     }
     
     *in_progress = true;
 
-    bool can_transfer_immediately = active_transfer.request_state == I2C_IDLE;
+    bool can_transfer_immediately = bus->active_transfer.request_state == I2C_IDLE;
     if (can_transfer_immediately) {
         // Don't queue if the bus is idle, just send it
         // Reserve bus to prevent any other calls to this function reserving the bus as well
-        active_transfer.request_state = I2C_PENDING;
+        bus->active_transfer.request_state = I2C_PENDING;
+        async_i2c_record_queue_wait(bus, request->priority, 0);
     } else {
         // Queue in data
-        pending_request_queue[request_queue_next_space].pending_request = request;
-        pending_request_queue[request_queue_next_space].in_progress = in_progress;
+        queue->entries[queue->next_space].pending_request = request;
+        queue->entries[queue->next_space].in_progress = in_progress;
+        queue->entries[queue->next_space].enqueue_time_us = time_us_32();
 
         // Increment ring buffer
-        request_queue_next_space = (request_queue_next_space + 1) % I2C_REQ_QUEUE_SIZE;
+        queue->next_space = (queue->next_space + 1) % I2C_REQ_QUEUE_SIZE;
     }
 
     restore_interrupts(prev_interrupt);
 
     if (can_transfer_immediately) {
-        async_i2c_start_request_internal(request, in_progress);
+        async_i2c_start_request_internal(bus, request, in_progress);
+    }
+
+    return ASYNC_I2C_ENQUEUE_OK;
+}
+
+// ========================================
+// Transaction Scripts
+// ========================================
+
+static void async_i2c_script_advance(struct async_i2c_script_state *state);
+
+/**
+ * @brief Finishes a script, calling the appropriate script callback
+ *
+ * @param state The script state to finish
+ * @param successful If the script completed all of its steps
+ * @param abort_data The abort data of the failed step if not successful
+ */
+static void async_i2c_script_finish(struct async_i2c_script_state *state, bool successful, uint32_t abort_data) {
+    const struct async_i2c_script *script = state->script;
+    *state->in_progress = false;
+
+    if (successful) {
+        if (script->completed_callback) {
+            script->completed_callback(state);
+        }
+    } else {
+        if (script->failed_callback) {
+            script->failed_callback(state, abort_data);
+        }
+    }
+}
+
+static void async_i2c_script_transfer_done(const struct async_i2c_request *req) {
+    struct async_i2c_script_state *state = (struct async_i2c_script_state *)req->user_data;
+    state->step++;
+    async_i2c_script_advance(state);
+}
+
+static void async_i2c_script_transfer_failed(const struct async_i2c_request *req, uint32_t abort_data) {
+    struct async_i2c_script_state *state = (struct async_i2c_script_state *)req->user_data;
+    const struct async_i2c_script *script = state->script;
+    uint8_t next_step = state->step + 1;
+
+    state->failures++;
+    if (next_step < script->num_steps && script->steps[next_step].op == ASYNC_I2C_SCRIPT_OP_BRANCH_ON_FAILURE &&
+            state->failures <= ASYNC_I2C_SCRIPT_MAX_FAILURES) {
+        state->step = script->steps[next_step].target_step;
+        async_i2c_script_advance(state);
+    } else {
+        async_i2c_script_finish(state, false, abort_data);
+    }
+}
+
+static int64_t async_i2c_script_delay_callback(__unused alarm_id_t id, void *user_data) {
+    struct async_i2c_script_state *state = (struct async_i2c_script_state *)user_data;
+    state->step++;
+    async_i2c_script_advance(state);
+    return 0;
+}
+
+/**
+ * @brief Runs the script from the current step until it must wait on the bus or a delay
+ *
+ * @param state The script state to advance
+ */
+static void async_i2c_script_advance(struct async_i2c_script_state *state) {
+    const struct async_i2c_script *script = state->script;
+
+    while (state->step < script->num_steps) {
+        const struct async_i2c_script_step *step = &script->steps[state->step];
+
+        if (step->op == ASYNC_I2C_SCRIPT_OP_TRANSFER) {
+            state->request.tx_buffer = step->tx_buffer;
+            state->request.rx_buffer = step->rx_buffer;
+            state->request.bytes_to_send = step->bytes_to_send;
+            state->request.bytes_to_receive = step->bytes_to_receive;
+            if (async_i2c_enqueue(&state->request, &state->request_in_progress) == ASYNC_I2C_ENQUEUE_QUEUE_FULL) {
+                // Handled as a failed transfer so the step can be retried by a branch
+                async_i2c_script_transfer_failed(&state->request, 0);
+            }
+            return;
+        } else if (step->op == ASYNC_I2C_SCRIPT_OP_DELAY) {
+            // The bus is released during the delay so other devices can use it
+            hard_assert(add_alarm_in_us(step->delay_us, &async_i2c_script_delay_callback, state, true) > 0);
+            return;
+        } else {
+            // Branches are only taken on failure of the previous step
+            state->step++;
+        }
     }
+
+    async_i2c_script_finish(state, true, 0);
+}
+
+/**
+ * @brief Validates an async_i2c_script
+ *
+ * @param script The script to validate
+ * @return true  Script is okay to run
+ * @return false Part of the script has an invalid value
+ */
+__unused static bool async_i2c_validate_script(const struct async_i2c_script *script) {
+    if (script->address >= 0x80 || i2c_reserved_addr(script->address) || script->priority >= ASYNC_I2C_NUM_PRIORITIES ||
+            script->speed >= ASYNC_I2C_NUM_SPEEDS) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < script->num_steps; i++) {
+        const struct async_i2c_script_step *step = &script->steps[i];
+
+        if (step->op == ASYNC_I2C_SCRIPT_OP_TRANSFER) {
+            if ((step->bytes_to_send == 0 && step->bytes_to_receive == 0) ||
+                    (step->bytes_to_send > 0 && step->tx_buffer == NULL) ||
+                    (step->bytes_to_receive > 0 && step->rx_buffer == NULL)) {
+                return false;
+            }
+        } else if (step->op == ASYNC_I2C_SCRIPT_OP_BRANCH_ON_FAILURE) {
+            if (step->target_step >= script->num_steps || i == 0 || script->steps[i-1].op != ASYNC_I2C_SCRIPT_OP_TRANSFER) {
+                return false;
+            }
+        } else if (step->op != ASYNC_I2C_SCRIPT_OP_DELAY) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void async_i2c_run_script(const struct async_i2c_script *script, struct async_i2c_script_state *state, bool *in_progress) {
+    valid_params_if(ASYNC_I2C, async_i2c_validate_script(script));
+    invalid_params_if(ASYNC_I2C, *in_progress);
+
+    *in_progress = true;
+    state->script = script;
+    state->in_progress = in_progress;
+    state->step = 0;
+    state->failures = 0;
+    state->request_in_progress = false;
+
+    state->request.i2c = script->i2c;
+    state->request.address = script->address;
+    state->request.nostop = false;
+    state->request.completed_callback = &async_i2c_script_transfer_done;
+    state->request.failed_callback = &async_i2c_script_transfer_failed;
+    state->request.next_req_on_success = NULL;
+    state->request.user_data = state;
+    state->request.priority = script->priority;
+    state->request.repeated_start = script->repeated_start;
+    state->request.speed = script->speed;
+
+    async_i2c_script_advance(state);
+}
+
+// ========================================
+// Statistics
+// ========================================
+
+void async_i2c_get_irq_stats(i2c_inst_t *i2c, struct async_i2c_irq_stats *stats) {
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = bus->irq_stats;
+    restore_interrupts(prev_interrupt);
+}
+
+void async_i2c_get_queue_stats(i2c_inst_t *i2c, enum async_i2c_priority priority, struct async_i2c_queue_stats *stats) {
+    invalid_params_if(ASYNC_I2C, priority >= ASYNC_I2C_NUM_PRIORITIES);
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = bus->queue_stats[priority];
+    restore_interrupts(prev_interrupt);
+}
+
+void async_i2c_get_bus_stats(i2c_inst_t *i2c, struct async_i2c_bus_stats *stats) {
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = bus->bus_stats;
+    stats->sample_time_us = time_us_64();
+    restore_interrupts(prev_interrupt);
+}
+
+void async_i2c_get_recovery_stats(i2c_inst_t *i2c, struct async_i2c_recovery_stats *stats) {
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = bus->recovery_stats;
+    restore_interrupts(prev_interrupt);
+}
+
+void async_i2c_get_speed_stats(i2c_inst_t *i2c, enum async_i2c_speed speed, struct async_i2c_speed_stats *stats) {
+    invalid_params_if(ASYNC_I2C, speed >= ASYNC_I2C_NUM_SPEEDS);
+    struct async_i2c_bus_state *bus = async_i2c_get_bus(i2c);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats = bus->speed_stats[speed];
+    restore_interrupts(prev_interrupt);
+}
+
+bool async_i2c_bus_idle(i2c_inst_t *i2c) {
+    // Requests are only left queued while another request is active, so an idle bus also has empty queues
+    return async_i2c_get_bus(i2c)->active_transfer.request_state == I2C_IDLE;
 }
 
 void async_i2c0_irq_handler(void) {
@@ -463,34 +1271,33 @@ void async_i2c1_irq_handler(void) {
     async_i2c_common_irq_handler(i2c1);
 }
 
-static void async_i2c_configure_interrupt_hw(i2c_inst_t *i2c) {
-    i2c->hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS | 
-                          I2C_IC_INTR_MASK_M_TX_OVER_BITS | I2C_IC_INTR_MASK_M_RX_OVER_BITS |
-                          I2C_IC_INTR_MASK_M_RX_UNDER_BITS;
-
-    i2c->hw->rx_tl = 10;
-    i2c->hw->tx_tl = 6;
-}
-
 void async_i2c_init(uint baudrate, uint bus_timeout_ms) {
     LOG_DEBUG("Initializing Async I2C");
     i2c_bus_timeout = bus_timeout_ms;
+    i2c_default_baudrate = baudrate;
+
+    struct async_i2c_bus_state *sensor_bus = async_i2c_get_bus(SENSOR_I2C_HW);
+    sensor_bus->i2c = SENSOR_I2C_HW;
+    sensor_bus->sda_pin = SENSOR_SDA_PIN;
+    sensor_bus->scl_pin = SENSOR_SCL_PIN;
+
+    struct async_i2c_bus_state *board_bus = async_i2c_get_bus(BOARD_I2C_HW);
+    board_bus->i2c = BOARD_I2C_HW;
+    board_bus->sda_pin = BOARD_SDA_PIN;
+    board_bus->scl_pin = BOARD_SCL_PIN;
+
+#if ASYNC_I2C_USE_DMA
+    for (int i = 0; i < NUM_I2CS; i++) {
+        bus_states[i].dma_tx_chan = dma_claim_unused_channel(true);
+        bus_states[i].dma_rx_chan = dma_claim_unused_channel(true);
+    }
+#endif
 
-    i2c_init(SENSOR_I2C_HW, baudrate);
-    gpio_set_function(SENSOR_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(SENSOR_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(SENSOR_SDA_PIN);
-    gpio_pull_up(SENSOR_SCL_PIN);
+    async_i2c_setup_bus_hw(sensor_bus);
     irq_set_exclusive_handler(I2C0_IRQ, &async_i2c0_irq_handler);
-    async_i2c_configure_interrupt_hw(SENSOR_I2C_HW);
 
-    i2c_init(BOARD_I2C_HW, baudrate);
-    gpio_set_function(BOARD_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(BOARD_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(BOARD_SDA_PIN);
-    gpio_pull_up(BOARD_SCL_PIN);
+    async_i2c_setup_bus_hw(board_bus);
     irq_set_exclusive_handler(I2C1_IRQ, &async_i2c1_irq_handler);
-    async_i2c_configure_interrupt_hw(BOARD_I2C_HW);
 
     irq_set_enabled(I2C0_IRQ, true);
     irq_set_enabled(I2C1_IRQ, true);
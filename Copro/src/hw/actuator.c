@@ -1,5 +1,4 @@
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include "drivers/async_i2c.h"
 
@@ -11,12 +10,14 @@
 
 #include "hw/actuator.h"
 #include "drivers/safety.h"
+#include "tasks/ros.h"
 
 #undef LOGGING_UNIT_NAME
 #define LOGGING_UNIT_NAME "actuator_interface"
 
 #define ACTUATOR_MAX_COMMANDS 8
 #define ACTUATOR_I2C_BUS SENSOR_I2C_HW
+#define ACTUATOR_I2C_SPEED ASYNC_I2C_SPEED_FAST  // Shared with Fm-only sensors, so Fast-mode Plus can't be used
 
 #define ACTUATOR_POLLING_RATE_MS 300
 #define ACTUATOR_MAX_STATUS_AGE_MS 1000
@@ -36,8 +37,68 @@ typedef struct actuator_command_data {
     actuator_cmd_response_cb_t response_cb;
     bool important_request;     // Set to true if the command being lost should be a fault
     bool in_use;
+    bool pooled;                // Set if the command was acquired from the command pool
+    struct actuator_command_data *next_free;
+    uint32_t send_time_us;      // Time the command was queued, for latency statistics
 } actuator_cmd_data_t;
 
+static void actuator_release_command(actuator_cmd_data_t *cmd);
+
+// ========================================
+// Command Statistics
+// ========================================
+
+// Commands are sent and completed from both interrupts and the main loop, so statistics are only modified with interrupts disabled
+static struct actuator_command_stats command_stats[ACTUATOR_NUM_COMMANDS] = {0};
+
+/**
+ * @brief Gets the statistics entry for the command's id
+ */
+static inline struct actuator_command_stats *actuator_stats_for(actuator_cmd_data_t *cmd) {
+    hard_assert_if(ACTUATOR, cmd->request.cmd_id >= ACTUATOR_NUM_COMMANDS);
+    return &command_stats[cmd->request.cmd_id];
+}
+
+static void actuator_record_sent(actuator_cmd_data_t *cmd) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    cmd->send_time_us = time_us_32();
+    actuator_stats_for(cmd)->sent++;
+    restore_interrupts(prev_interrupt);
+}
+
+static void actuator_record_completed(actuator_cmd_data_t *cmd) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    struct actuator_command_stats *stats = actuator_stats_for(cmd);
+    uint32_t latency_us = time_us_32() - cmd->send_time_us;
+    if (stats->completed == 0 || latency_us < stats->latency_min_us) {
+        stats->latency_min_us = latency_us;
+    }
+    if (latency_us > stats->latency_max_us) {
+        stats->latency_max_us = latency_us;
+    }
+    stats->latency_total_us += latency_us;
+    stats->completed++;
+    restore_interrupts(prev_interrupt);
+}
+
+static void actuator_record_crc_error(actuator_cmd_data_t *cmd) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    actuator_stats_for(cmd)->crc_errors++;
+    restore_interrupts(prev_interrupt);
+}
+
+static void actuator_record_failed(actuator_cmd_data_t *cmd) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    actuator_stats_for(cmd)->failed++;
+    restore_interrupts(prev_interrupt);
+}
+
+static void actuator_record_failed_result(actuator_cmd_data_t *cmd) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    actuator_stats_for(cmd)->failed_results++;
+    restore_interrupts(prev_interrupt);
+}
+
 /**
  * @brief Common callback for completion of actuator i2c request
  * This checks the crc value of the response if there is one, and will call the request callback if one provided on successful completion
@@ -54,6 +115,7 @@ static void actuator_command_done(__unused const struct async_i2c_request * req)
         uint8_t crc_calc = actuator_i2c_crc8_calc_response(&cmd->response, cmd->i2c_request.bytes_to_receive);
         if (crc_calc != cmd->response.crc8) {
             LOG_WARN("CRC Mismatch: 0x%02x calculated, 0x%02x received", crc_calc, cmd->response.crc8)
+            actuator_record_crc_error(cmd);
             if (cmd->important_request) {
                 safety_raise_fault(FAULT_ACTUATOR_FAIL);
             }
@@ -62,6 +124,10 @@ static void actuator_command_done(__unused const struct async_i2c_request * req)
         }
     }
 
+    if (request_successful) {
+        actuator_record_completed(cmd);
+    }
+
     if (request_successful && cmd->response_cb){
         if (cmd->response_cb(cmd)){
             can_release_request = false;
@@ -69,7 +135,7 @@ static void actuator_command_done(__unused const struct async_i2c_request * req)
     }
 
     if (can_release_request) {
-        cmd->in_use = false;
+        actuator_release_command(cmd);
     }
 }
 
@@ -81,13 +147,14 @@ static void actuator_command_done(__unused const struct async_i2c_request * req)
  */
 static void actuator_command_failed(__unused const struct async_i2c_request * req, uint32_t abort_data){
     actuator_cmd_data_t* cmd = (actuator_cmd_data_t*)req->user_data;
+    actuator_record_failed(cmd);
     if (cmd->important_request) {
         LOG_ERROR("Failed to send important actuator command %d: Abort Data 0x%x", cmd->request.cmd_id, abort_data);
         safety_raise_fault(FAULT_ACTUATOR_FAIL);
     } else {
         LOG_WARN("Failed to send actuator command %d: Abort Data 0x%x", cmd->request.cmd_id, abort_data);
     }
-    cmd->in_use = false;
+    actuator_release_command(cmd);
 }
 
 /**
@@ -110,6 +177,8 @@ static void actuator_populate_command(actuator_cmd_data_t* cmd, enum actuator_co
     cmd->i2c_request.failed_callback = actuator_command_failed;
     cmd->i2c_request.next_req_on_success = NULL;
     cmd->i2c_request.user_data = cmd;
+    cmd->i2c_request.priority = ASYNC_I2C_PRIORITY_NORMAL;
+    cmd->i2c_request.speed = ACTUATOR_I2C_SPEED;
 
     cmd->i2c_in_progress = false;
     cmd->response_cb = response_cb;
@@ -118,34 +187,111 @@ static void actuator_populate_command(actuator_cmd_data_t* cmd, enum actuator_co
     cmd->important_request = important;
 }
 
+/**
+ * @brief If the actuator board firmware supports batch commands
+ * Set from the firmware version in the status response
+ */
+static bool actuator_batch_supported = false;
+
+/**
+ * @brief If the actuator board firmware supports timing tables and reports its timing hash
+ * Set from the firmware version in the status response
+ */
+static bool actuator_timing_table_supported = false;
+
+/**
+ * @brief Populates cmd with an empty batch frame
+ * Entries are added with actuator_i2c_batch_add, then actuator_finish_batch must be called before sending
+ *
+ * @param cmd The command to populate
+ * @param response_cb The callback to call on a successful response from the actuators
+ * @param important If a failure of this command should be made immediately known
+ */
+static void actuator_populate_batch(actuator_cmd_data_t* cmd, actuator_cmd_response_cb_t response_cb, bool important) {
+    actuator_populate_command(cmd, ACTUATOR_CMD_BATCH, response_cb, important);
+    actuator_i2c_batch_init(&cmd->request);
+}
+
+/**
+ * @brief Sets the transfer sizes of the request for the entries added to the batch
+ *
+ * @param cmd The batch command to finish
+ */
+static void actuator_finish_batch(actuator_cmd_data_t* cmd) {
+    size_t response_size = 0;
+    hard_assert(actuator_i2c_batch_get_response_size(&cmd->request.data.batch, &response_size));
+
+    cmd->i2c_request.bytes_to_send = actuator_i2c_batch_get_cmd_size(&cmd->request);
+    cmd->i2c_request.bytes_to_receive = response_size;
+}
+
+
+// Commands are handed out from a statically allocated free list
+// Commands are released from the i2c interrupt, so the list is only modified with interrupts disabled
+static actuator_cmd_data_t command_pool[ACTUATOR_MAX_COMMANDS];
+static actuator_cmd_data_t *command_free_list = NULL;
+static struct actuator_command_pool_stats command_pool_stats = {0};
+
+/**
+ * @brief Builds the free list from the command pool
+ */
+static void actuator_command_pool_init(void) {
+    for (int i = 0; i < ACTUATOR_MAX_COMMANDS; i++) {
+        command_pool[i].in_use = false;
+        command_pool[i].i2c_in_progress = false;
+        command_pool[i].pooled = true;
+        command_pool[i].next_free = (i + 1 < ACTUATOR_MAX_COMMANDS ? &command_pool[i + 1] : NULL);
+    }
+    command_free_list = &command_pool[0];
+}
+
+/**
+ * @brief Releases a command after it has finished
+ * Commands from the pool are returned to the free list, other commands are marked as no longer in use
+ *
+ * INTERRUPT SAFE
+ *
+ * @param cmd The command to release
+ */
+static void actuator_release_command(actuator_cmd_data_t *cmd) {
+    if (!cmd->pooled) {
+        cmd->in_use = false;
+        return;
+    }
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    cmd->in_use = false;
+    cmd->next_free = command_free_list;
+    command_free_list = cmd;
+    command_pool_stats.in_use--;
+    restore_interrupts(prev_interrupt);
+}
 
-static actuator_cmd_data_t *allocated_commands[ACTUATOR_MAX_COMMANDS];
-static int num_allocated_commands = 0;
 /**
  * @brief Generates a command with the specified command id and response callback.
  * CAN RETURN NULL IF UNABLE TO GET A REQUEST
  * IT IS THE CALLERS RESPONSIBILITY TO HANDLE THIS
  *
- * NOT INTERRUPT SAFE
+ * INTERRUPT SAFE
  *
  * @param cmd_id The command id for the request
  * @param response_cb The callback to call on a successful response from the actuators. Can be NULL if no response is needed
  * @return actuator_cmd_data_t* The command allocated or NULL if a command could not be generated
  */
 static actuator_cmd_data_t* actuator_generate_command(enum actuator_command cmd_id, actuator_cmd_response_cb_t response_cb) {
-    actuator_cmd_data_t * cmd = NULL;
-    // Skip the static allocation to save for non-interrupt safe requests
-    for (int i = 0; i < num_allocated_commands; i++) {
-        if (!allocated_commands[i]->in_use) {
-            allocated_commands[i]->in_use = true;
-            cmd = allocated_commands[i];
-        }
-    }
-    if (!cmd && num_allocated_commands < ACTUATOR_MAX_COMMANDS) {
-        cmd = malloc(sizeof(*cmd));
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    actuator_cmd_data_t *cmd = command_free_list;
+    if (cmd) {
+        command_free_list = cmd->next_free;
         cmd->in_use = true;
-        allocated_commands[num_allocated_commands++] = cmd;
+        command_pool_stats.in_use++;
+        if (command_pool_stats.in_use > command_pool_stats.high_water_mark) {
+            command_pool_stats.high_water_mark = command_pool_stats.in_use;
+        }
+    } else {
+        command_pool_stats.allocation_failures++;
     }
+    restore_interrupts(prev_interrupt);
 
     if (cmd) {
         actuator_populate_command(cmd, cmd_id, response_cb, true);
@@ -163,7 +309,17 @@ static actuator_cmd_data_t* actuator_generate_command(enum actuator_command cmd_
 static void actuator_send_command(actuator_cmd_data_t * cmd) {
     cmd->request.crc8 = actuator_i2c_crc8_calc_command(&cmd->request, cmd->i2c_request.bytes_to_send);
 
-    async_i2c_enqueue(&cmd->i2c_request, &cmd->i2c_in_progress);
+    actuator_record_sent(cmd);
+    if (async_i2c_enqueue(&cmd->i2c_request, &cmd->i2c_in_progress) == ASYNC_I2C_ENQUEUE_QUEUE_FULL) {
+        actuator_record_failed(cmd);
+        if (cmd->important_request) {
+            LOG_ERROR("Unable to queue important actuator command %d", cmd->request.cmd_id);
+            safety_raise_fault(FAULT_ACTUATOR_FAIL);
+        } else {
+            LOG_WARN("Unable to queue actuator command %d", cmd->request.cmd_id);
+        }
+        actuator_release_command(cmd);
+    }
 }
 
 // ========================================
@@ -189,28 +345,44 @@ static struct missing_timings_status missing_timings;
 
 
 static bool actuator_set_timing_general_cb(actuator_cmd_data_t *cmd);
-static bool actuator_update_missing_timings_common(actuator_cmd_data_t *cmd) {
+
+/**
+ * @brief Fills entry with the next timing command that needs to be sent to the actuator board
+ * The timing is only marked as sent if clear_missing is true, so the command can be checked to fit in a batch first
+ *
+ * @param entry The command to fill. Only the command id and data are set
+ * @param clear_missing If the timing should be marked as sent
+ * @return true A timing needs to be sent and has been written to entry
+ * @return false No timings need to be sent
+ */
+static bool actuator_next_missing_timing(actuator_i2c_cmd_t *entry, bool clear_missing) {
     if ((missing_timings.claw_open_timing || missing_timings.claw_close_timing) && claw_timing.set) {
-        actuator_populate_command(cmd, ACTUATOR_CMD_CLAW_TIMING, actuator_set_timing_general_cb, true);
-        cmd->request.data.claw_timing.open_time_ms = claw_timing.timing;
-        cmd->request.data.claw_timing.close_time_ms = claw_timing.timing;
+        entry->cmd_id = ACTUATOR_CMD_CLAW_TIMING;
+        entry->data.claw_timing.open_time_ms = claw_timing.timing;
+        entry->data.claw_timing.close_time_ms = claw_timing.timing;
 
-        missing_timings.claw_open_timing = false;
-        missing_timings.claw_close_timing = false;
+        if (clear_missing) {
+            missing_timings.claw_open_timing = false;
+            missing_timings.claw_close_timing = false;
+        }
     }
     else if (missing_timings.dropper_active_timing && dropper_active_timing.set) {
-        actuator_populate_command(cmd, ACTUATOR_CMD_DROPPER_TIMING, actuator_set_timing_general_cb, true);
-        cmd->request.data.dropper_timing.active_time_ms = dropper_active_timing.timing;
+        entry->cmd_id = ACTUATOR_CMD_DROPPER_TIMING;
+        entry->data.dropper_timing.active_time_ms = dropper_active_timing.timing;
 
-        missing_timings.dropper_active_timing = false;
+        if (clear_missing) {
+            missing_timings.dropper_active_timing = false;
+        }
     }
     #define ELSE_IF_TORPEDO_TIMING_NEEDED(torp_num, coil_lower, coil_upper) \
         else if (missing_timings.torpedo##torp_num##_##coil_lower##_timing && torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME].set) { \
-            actuator_populate_command(cmd, ACTUATOR_CMD_TORPEDO_TIMING, actuator_set_timing_general_cb, true); \
-            cmd->request.data.torpedo_timing.torpedo_num = torp_num; \
-            cmd->request.data.torpedo_timing.timing_type = ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME; \
-            cmd->request.data.torpedo_timing.time_us = torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME].timing; \
-            missing_timings.torpedo##torp_num##_##coil_lower##_timing = false; \
+            entry->cmd_id = ACTUATOR_CMD_TORPEDO_TIMING; \
+            entry->data.torpedo_timing.torpedo_num = torp_num; \
+            entry->data.torpedo_timing.timing_type = ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME; \
+            entry->data.torpedo_timing.time_us = torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME].timing; \
+            if (clear_missing) { \
+                missing_timings.torpedo##torp_num##_##coil_lower##_timing = false; \
+            } \
         }
     ELSE_IF_TORPEDO_TIMING_NEEDED(1, coil1_on,      COIL1_ON)
     ELSE_IF_TORPEDO_TIMING_NEEDED(1, coil1_2_delay, COIL1_2_DELAY)
@@ -226,6 +398,30 @@ static bool actuator_update_missing_timings_common(actuator_cmd_data_t *cmd) {
         return false;
     }
 
+    return true;
+}
+
+static bool actuator_update_missing_timings_common(actuator_cmd_data_t *cmd) {
+    actuator_i2c_cmd_t entry;
+    if (!actuator_next_missing_timing(&entry, !actuator_batch_supported)) {
+        return false;
+    }
+
+    if (actuator_batch_supported) {
+        // Send as many timings as fit in a single batch
+        actuator_populate_batch(cmd, actuator_set_timing_general_cb, true);
+        while (actuator_i2c_batch_add(&cmd->request, &entry)) {
+            actuator_next_missing_timing(&entry, true);
+            if (!actuator_next_missing_timing(&entry, false)) {
+                break;
+            }
+        }
+        actuator_finish_batch(cmd);
+    } else {
+        actuator_populate_command(cmd, entry.cmd_id, actuator_set_timing_general_cb, true);
+        memcpy(&cmd->request.data, &entry.data, sizeof(entry.data));
+    }
+
     actuator_send_command(cmd);
 
     return true;
@@ -233,9 +429,14 @@ static bool actuator_update_missing_timings_common(actuator_cmd_data_t *cmd) {
 
 
 static bool actuator_set_timing_general_cb(actuator_cmd_data_t *cmd) {
-    if (cmd->response.data.result != ACTUATOR_RESULT_SUCCESSFUL) {
-        LOG_ERROR("Failed to set actuator timing (cmd %d)", cmd->request.cmd_id);
-        safety_raise_fault(FAULT_ACTUATOR_FAIL);
+    // Timing commands only return a result, so a batch has one result byte per timing
+    int num_results = cmd->i2c_request.bytes_to_receive - ACTUATOR_BASE_RESPONSE_LENGTH;
+    for (int i = 0; i < num_results; i++) {
+        if (cmd->response.data.batch[i] != ACTUATOR_RESULT_SUCCESSFUL) {
+            actuator_record_failed_result(cmd);
+            LOG_ERROR("Failed to set actuator timing (cmd %d, entry %d)", cmd->request.cmd_id, i);
+            safety_raise_fault(FAULT_ACTUATOR_FAIL);
+        }
     }
 
     return actuator_update_missing_timings_common(cmd);
@@ -252,108 +453,179 @@ static void actuator_update_missing_timings(void) {
     }
 }
 
-#define RC_RETURN_CHECK(fn) { rcl_ret_t temp_rc = fn; if((temp_rc != RCL_RET_OK)){return temp_rc;}}
-rcl_ret_t actuator_create_parameters(rclc_parameter_server_t *param_server) {
-    if (!actuator_initialized) {
-        return RCL_RET_OK;
+/**
+ * @brief Fills table with all of the cached timings
+ *
+ * @param table The timing table to fill
+ * @return true All timings have been received from ROS and the table is complete
+ * @return false Some timings have not been set, so the table cannot be used to check the actuator board's timings
+ */
+static bool actuator_build_timing_table(struct timing_table_cmd *table) {
+    bool complete = claw_timing.set && dropper_active_timing.set;
+
+    table->claw_open_time_ms = claw_timing.timing;
+    table->claw_close_time_ms = claw_timing.timing;
+    table->dropper_active_time_ms = dropper_active_timing.timing;
+    for (int i = 0; i < ACTUATOR_NUM_TORPEDO_TIMINGS; i++) {
+        table->torpedo1_timings_us[i] = torpedo1_timings[i].timing;
+        table->torpedo2_timings_us[i] = torpedo2_timings[i].timing;
+        complete = complete && torpedo1_timings[i].set && torpedo2_timings[i].set;
+    }
+
+    return complete;
+}
+
+/**
+ * @brief Sends every cached timing in a single transaction if the actuator board's timing hash doesn't match
+ *
+ * @param reported_hash The timing hash reported by the actuator board
+ */
+static void actuator_sync_timing_table(uint16_t reported_hash) {
+    if (set_timing_command.in_use) {
+        return;     // A timing update is in progress, the hash will be checked again on the next status
     }
 
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "claw_timing_ms", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "dropper_active_timing_ms", RCLC_PARAMETER_INT));
+    struct timing_table_cmd table;
+    if (!actuator_build_timing_table(&table) || actuator_i2c_timing_table_hash(&table) == reported_hash) {
+        return;
+    }
 
-	RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo1_coil1_on_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo1_coil1_2_delay_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo1_coil2_on_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo1_coil2_3_delay_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo1_coil3_on_timing_us", RCLC_PARAMETER_INT));
+    // The table sends every timing, so any individually missing timings are covered by it
+    memset(&missing_timings, 0, sizeof(missing_timings));
 
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo2_coil1_on_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo2_coil1_2_delay_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo2_coil2_on_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo2_coil2_3_delay_timing_us", RCLC_PARAMETER_INT));
-    RC_RETURN_CHECK(rclc_add_parameter(param_server, "torpedo2_coil3_on_timing_us", RCLC_PARAMETER_INT));
+    set_timing_command.in_use = true;
+    actuator_populate_command(&set_timing_command, ACTUATOR_CMD_TIMING_TABLE, actuator_set_timing_general_cb, true);
+    memcpy(&set_timing_command.request.data.timing_table, &table, sizeof(table));
+    actuator_send_command(&set_timing_command);
+}
 
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "claw_timing_ms", 4500));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "dropper_active_timing_ms", 250));
+// ========================================
+// Parameters
+// ========================================
 
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo1_coil1_on_timing_us", 23000));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo1_coil1_2_delay_timing_us", 250));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo1_coil2_on_timing_us", 15000));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo1_coil2_3_delay_timing_us", 250));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo1_coil3_on_timing_us", 13000));
+struct actuator_parameter;
+typedef void (*actuator_parameter_apply_t)(const struct actuator_parameter *param, int64_t value);
 
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo2_coil1_on_timing_us", 23000));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo2_coil1_2_delay_timing_us", 250));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo2_coil2_on_timing_us", 15000));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo2_coil2_3_delay_timing_us", 250));
-    RC_RETURN_CHECK(rclc_parameter_set_int(param_server, "torpedo2_coil3_on_timing_us", 13000));
+/**
+ * @brief Descriptor for an actuator parameter on the ROS parameter server
+ */
+struct actuator_parameter {
+    const char *name;
+    rclc_parameter_type_t type;
+    int64_t default_value;
+    int64_t min_value;
+    int64_t max_value;
+    struct timing_entry *storage;
+    struct missing_timings_status missing;      // The timings to send to the actuator board when the parameter changes
+    actuator_parameter_apply_t apply;
+};
 
-    return RCL_RET_OK;
+/**
+ * @brief Stores a new timing and sends it to the actuator board
+ */
+static void actuator_apply_timing_parameter(const struct actuator_parameter *param, int64_t value) {
+    param->storage->timing = value;
+    param->storage->set = true;
+
+    static_assert(sizeof(param->missing) == sizeof(uint16_t));
+    *((uint16_t*)(&missing_timings)) |= *((const uint16_t*)(&param->missing));
+    actuator_update_missing_timings();
 }
 
-#define IS_VALID_TIMING(num) ((num) > 0 && (num) < (1<<16))
-bool actuator_handle_parameter_change(Parameter * param) {
-    if (!actuator_initialized) {
-        return false;
+#define TIMING_PARAMETER(param_name, storage_ptr, default_timing, ...) \
+    {.name = param_name, .type = RCLC_PARAMETER_INT, .default_value = default_timing, .min_value = 1, .max_value = UINT16_MAX, \
+     .storage = storage_ptr, .missing = {__VA_ARGS__}, .apply = actuator_apply_timing_parameter}
+#define TORPEDO_TIMING_PARAMETER(torp_num, coil_lower, coil_upper, default_timing) \
+    TIMING_PARAMETER("torpedo" #torp_num "_" #coil_lower "_timing_us", &torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME], \
+                     default_timing, .torpedo##torp_num##_##coil_lower##_timing = 1)
+
+// Parameters are registered in table order, so the server's parameter list index maps directly to the table
+static const struct actuator_parameter actuator_parameters[] = {
+    TIMING_PARAMETER("claw_timing_ms", &claw_timing, 4500, .claw_open_timing = 1, .claw_close_timing = 1),
+    TIMING_PARAMETER("dropper_active_timing_ms", &dropper_active_timing, 250, .dropper_active_timing = 1),
+
+    TORPEDO_TIMING_PARAMETER(1, coil1_on,      COIL1_ON,      23000),
+    TORPEDO_TIMING_PARAMETER(1, coil1_2_delay, COIL1_2_DELAY, 250),
+    TORPEDO_TIMING_PARAMETER(1, coil2_on,      COIL2_ON,      15000),
+    TORPEDO_TIMING_PARAMETER(1, coil2_3_delay, COIL2_3_DELAY, 250),
+    TORPEDO_TIMING_PARAMETER(1, coil3_on,      COIL3_ON,      13000),
+
+    TORPEDO_TIMING_PARAMETER(2, coil1_on,      COIL1_ON,      23000),
+    TORPEDO_TIMING_PARAMETER(2, coil1_2_delay, COIL1_2_DELAY, 250),
+    TORPEDO_TIMING_PARAMETER(2, coil2_on,      COIL2_ON,      15000),
+    TORPEDO_TIMING_PARAMETER(2, coil2_3_delay, COIL2_3_DELAY, 250),
+    TORPEDO_TIMING_PARAMETER(2, coil3_on,      COIL3_ON,      13000),
+};
+static_assert(sizeof(actuator_parameters) / sizeof(*actuator_parameters) == ACTUATOR_NUM_PARAMETERS, "ACTUATOR_NUM_PARAMETERS does not match the parameter table");
+
+// The server the parameters were registered on, and the index of the first actuator parameter in its parameter list
+static rclc_parameter_server_t *actuator_param_server = NULL;
+static size_t actuator_param_base_index = 0;
+
+/**
+ * @brief Finds the descriptor for a parameter
+ * The parameter is located by its position in the server's parameter list, only falling back to a name search if it isn't found there
+ *
+ * @param param The parameter to find
+ * @return const struct actuator_parameter* The descriptor, or NULL if param is not an actuator parameter
+ */
+static const struct actuator_parameter *actuator_find_parameter(Parameter *param) {
+    if (!actuator_param_server) {
+        return NULL;
     }
 
-    // All parameters are int types
-    if (param->value.type != RCLC_PARAMETER_INT) {
-        return false;
+    Parameter *list = actuator_param_server->parameter_list.data;
+    if (param >= list && param < list + actuator_param_server->parameter_list.size) {
+        size_t index = (param - list) - actuator_param_base_index;
+        if (index < ACTUATOR_NUM_PARAMETERS && !strcmp(param->name.data, actuator_parameters[index].name)) {
+            return &actuator_parameters[index];
+        }
+        return NULL;
     }
 
-    if (!strcmp(param->name.data, "claw_timing_ms")) {
-        if (IS_VALID_TIMING(param->value.integer_value)) {
-            claw_timing.timing = param->value.integer_value;
-            claw_timing.set = true;
+    for (size_t i = 0; i < ACTUATOR_NUM_PARAMETERS; i++) {
+        if (!strcmp(param->name.data, actuator_parameters[i].name)) {
+            return &actuator_parameters[i];
+        }
+    }
+    return NULL;
+}
 
-            missing_timings.claw_open_timing = true;
-            missing_timings.claw_close_timing = true;
-            actuator_update_missing_timings();
+rcl_ret_t actuator_create_parameters(rclc_parameter_server_t *param_server) {
+    if (!actuator_initialized) {
+        return RCL_RET_OK;
+    }
 
-            return true;
-        } else {
-            return false;
-        }
-    } else if (!strcmp(param->name.data, "dropper_active_timing_ms")) {
-        if (IS_VALID_TIMING(param->value.integer_value)) {
-            dropper_active_timing.timing = param->value.integer_value;
-            dropper_active_timing.set = true;
+    actuator_param_server = param_server;
+    actuator_param_base_index = param_server->parameter_list.size;
+    for (size_t i = 0; i < ACTUATOR_NUM_PARAMETERS; i++) {
+        RC_RETURN_CHECK(rclc_add_parameter(param_server, actuator_parameters[i].name, actuator_parameters[i].type));
+    }
 
-            missing_timings.dropper_active_timing = true;
-            actuator_update_missing_timings();
+    for (size_t i = 0; i < ACTUATOR_NUM_PARAMETERS; i++) {
+        RC_RETURN_CHECK(rclc_parameter_set_int(param_server, actuator_parameters[i].name, actuator_parameters[i].default_value));
+    }
 
-            return true;
-        } else {
-            return false;
-        }
+    return RCL_RET_OK;
+}
+
+bool actuator_handle_parameter_change(Parameter * param) {
+    if (!actuator_initialized) {
+        return false;
     }
-    #define ELSE_IF_TORPEDO_PARAMETER(torp_num, coil_lower, coil_upper) \
-        else if (!strcmp(param->name.data, "torpedo" #torp_num "_" #coil_lower "_timing_us")) { \
-            if (IS_VALID_TIMING(param->value.integer_value)) { \
-                torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME].timing = param->value.integer_value; \
-                torpedo##torp_num##_timings[ACTUATOR_TORPEDO_TIMING_##coil_upper##_TIME].set = true; \
-                missing_timings.torpedo##torp_num##_##coil_lower##_timing = true; \
-                actuator_update_missing_timings(); \
-                return true; \
-            } else { \
-                return false; \
-            } \
-        }
-    ELSE_IF_TORPEDO_PARAMETER(1, coil1_on,      COIL1_ON)
-    ELSE_IF_TORPEDO_PARAMETER(1, coil1_2_delay, COIL1_2_DELAY)
-    ELSE_IF_TORPEDO_PARAMETER(1, coil2_on,      COIL2_ON)
-    ELSE_IF_TORPEDO_PARAMETER(1, coil2_3_delay, COIL2_3_DELAY)
-    ELSE_IF_TORPEDO_PARAMETER(1, coil3_on,      COIL3_ON)
-    ELSE_IF_TORPEDO_PARAMETER(2, coil1_on,      COIL1_ON)
-    ELSE_IF_TORPEDO_PARAMETER(2, coil1_2_delay, COIL1_2_DELAY)
-    ELSE_IF_TORPEDO_PARAMETER(2, coil2_on,      COIL2_ON)
-    ELSE_IF_TORPEDO_PARAMETER(2, coil2_3_delay, COIL2_3_DELAY)
-    ELSE_IF_TORPEDO_PARAMETER(2, coil3_on,      COIL3_ON)
 
-    else {
+    const struct actuator_parameter *desc = actuator_find_parameter(param);
+    if (!desc || param->value.type != desc->type) {
+        return false;
+    }
+
+    int64_t value = param->value.integer_value;
+    if (value < desc->min_value || value > desc->max_value) {
         return false;
     }
+
+    desc->apply(desc, value);
+    return true;
 }
 
 
@@ -368,11 +640,15 @@ static actuator_cmd_data_t kill_switch_update_command = {.in_use = false, .i2c_i
 static absolute_time_t status_valid_timeout = {0};
 static bool version_warning_printed = false;
 static bool kill_switch_needs_refresh = false;
+// The entries batched after the status in the running status request
+static bool status_batch_has_kill_switch = false;
+static bool status_batch_has_timing_hash = false;
 
 static bool actuator_kill_switch_update_callback(actuator_cmd_data_t * cmd) {
     assert(cmd == &kill_switch_update_command);
 
     if (cmd->response.data.result != ACTUATOR_RESULT_SUCCESSFUL) {
+        actuator_record_failed_result(cmd);
         LOG_ERROR("Non-successful kill switch update response %d", cmd->response.data.result);
         safety_raise_fault(FAULT_ACTUATOR_FAIL);
     } else if (kill_switch_needs_refresh) {
@@ -386,8 +662,35 @@ static bool actuator_kill_switch_update_callback(actuator_cmd_data_t * cmd) {
 }
 
 static bool actuator_status_callback(actuator_cmd_data_t * cmd) {
+    // When batched, the status is the first entry so it is at the start of the response, followed by the kill switch result
+    // and then the timing hash, if they were sent
     struct actuator_i2c_status *status = &cmd->response.data.status;
-    if (status->firmware_status.version_major != ACTUATOR_EXPECTED_FIRMWARE_MAJOR && status->firmware_status.version_major != ACTUATOR_EXPECTED_FIRMWARE_MINOR) {
+    bool batched = (cmd->request.cmd_id == ACTUATOR_CMD_BATCH);
+    size_t response_offset = ACTUATOR_STATUS_LENGTH;
+
+    bool kill_switch_sent = (batched && status_batch_has_kill_switch);
+    if (kill_switch_sent) {
+        if (cmd->response.data.batch[response_offset] != ACTUATOR_RESULT_SUCCESSFUL) {
+            actuator_record_failed_result(cmd);
+            LOG_ERROR("Non-successful kill switch update response %d", cmd->response.data.batch[response_offset]);
+            safety_raise_fault(FAULT_ACTUATOR_FAIL);
+        }
+        response_offset += ACTUATOR_RESULT_LENGTH;
+    }
+
+    bool timing_hash_received = (batched && status_batch_has_timing_hash);
+    struct actuator_i2c_timing_hash timing_hash;
+    if (timing_hash_received) {
+        memcpy(&timing_hash, &cmd->response.data.batch[response_offset], sizeof(timing_hash));
+    }
+
+    bool major_version_matches = (status->firmware_status.version_major == ACTUATOR_EXPECTED_FIRMWARE_MAJOR);
+
+    // Protocol features are only known by their minor version within the expected major version
+    actuator_batch_supported = (major_version_matches && status->firmware_status.version_minor >= ACTUATOR_BATCH_MIN_FIRMWARE_MINOR);
+    actuator_timing_table_supported = (major_version_matches && status->firmware_status.version_minor >= ACTUATOR_TIMING_TABLE_MIN_FIRMWARE_MINOR);
+
+    if (!major_version_matches) {
         if (!version_warning_printed) {
             LOG_ERROR("Invalid firmware version found: %d.%d (%d.%d expected)", status->firmware_status.version_major, status->firmware_status.version_minor, ACTUATOR_EXPECTED_FIRMWARE_MAJOR, ACTUATOR_EXPECTED_FIRMWARE_MINOR);
             safety_raise_fault(FAULT_ACTUATOR_FAIL);
@@ -397,7 +700,7 @@ static bool actuator_status_callback(actuator_cmd_data_t * cmd) {
         memcpy(&actuator_last_status, status, sizeof(*status));
         status_valid_timeout = make_timeout_time_ms(ACTUATOR_MAX_STATUS_AGE_MS);
 
-        if (safety_initialized) {
+        if (safety_initialized && !kill_switch_sent) {
             if (!kill_switch_update_command.in_use) {
                 kill_switch_needs_refresh = false;
                 kill_switch_update_command.request.data.kill_switch.asserting_kill = safety_kill_get_asserting_kill();
@@ -413,12 +716,51 @@ static bool actuator_status_callback(actuator_cmd_data_t * cmd) {
         uint16_t *raw_cached_missing_timings = (uint16_t*)(&missing_timings);
         if (*raw_status_missing_timings) {
             *raw_cached_missing_timings |= *raw_status_missing_timings;
+        }
+
+        if (timing_hash_received) {
+            actuator_sync_timing_table(timing_hash.timing_hash);
+        }
+        if (*raw_cached_missing_timings) {
+            // Anything not covered by a timing table (timings not yet received from ROS) is sent individually
             actuator_update_missing_timings();
         }
     }
     return false;
 }
 
+/**
+ * @brief Populates and sends status_command to fetch the actuator board status
+ * The caller must have set status_command.in_use
+ */
+static void actuator_send_status_request(void) {
+    // Send the kill switch state and fetch the timing hash in the same transaction as the status poll
+    status_batch_has_kill_switch = (actuator_batch_supported && safety_initialized);
+    status_batch_has_timing_hash = (actuator_batch_supported && actuator_timing_table_supported);
+
+    if (status_batch_has_kill_switch || status_batch_has_timing_hash) {
+        actuator_populate_batch(&status_command, actuator_status_callback, false);
+        actuator_i2c_batch_add(&status_command.request, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_STATUS});
+        if (status_batch_has_kill_switch) {
+            actuator_i2c_cmd_t kill_switch_entry = {.cmd_id = ACTUATOR_CMD_KILL_SWITCH};
+            kill_switch_entry.data.kill_switch.asserting_kill = safety_kill_get_asserting_kill();
+            actuator_i2c_batch_add(&status_command.request, &kill_switch_entry);
+        }
+        if (status_batch_has_timing_hash) {
+            actuator_i2c_batch_add(&status_command.request, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_TIMING_HASH});
+        }
+        actuator_finish_batch(&status_command);
+
+        if (status_batch_has_kill_switch) {
+            // The batch carries the kill switch, so it gets the same priority as a standalone kill switch update
+            status_command.i2c_request.priority = ASYNC_I2C_PRIORITY_HIGH;
+        }
+    } else {
+        actuator_populate_command(&status_command, ACTUATOR_CMD_GET_STATUS, actuator_status_callback, false);
+    }
+    actuator_send_command(&status_command);
+}
+
 static bool actuator_has_been_polled = false;
 /**
  * @brief Alarm callback to poll the actuator board
@@ -439,11 +781,11 @@ static int64_t actuator_poll_alarm_callback(__unused alarm_id_t id, __unused voi
     }
 
     if (status_command.in_use) {
-        LOG_ERROR("Unable to poll actuator board, request still in progress");
-        safety_raise_fault(FAULT_ACTUATOR_FAIL);
+        // The bus is running behind, so skip this poll. A lost connection is still caught by the status age
+        LOG_WARN("Skipping actuator poll, previous request still in progress");
     } else {
         status_command.in_use = true;
-        actuator_send_command(&status_command);
+        actuator_send_status_request();
     }
 
     return ACTUATOR_POLLING_RATE_MS * 1000;
@@ -455,6 +797,7 @@ static int64_t actuator_poll_alarm_callback(__unused alarm_id_t id, __unused voi
 
 static bool actuator_generic_result_cb(actuator_cmd_data_t * cmd) {
     if (cmd->response.data.result == ACTUATOR_RESULT_FAILED){
+        actuator_record_failed_result(cmd);
         if (cmd->important_request) {
             LOG_ERROR("Request %d returned failed result %d", cmd->request.cmd_id, cmd->response.data.result);
             safety_raise_fault(FAULT_ACTUATOR_FAIL);
@@ -612,12 +955,30 @@ void actuator_kill_report_refresh(void) {
     }
 }
 
+void actuator_get_command_pool_stats(struct actuator_command_pool_stats *stats_out) {
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats_out = command_pool_stats;
+    restore_interrupts(prev_interrupt);
+}
+
+void actuator_get_command_stats(enum actuator_command cmd_id, struct actuator_command_stats *stats_out) {
+    hard_assert_if(ACTUATOR, cmd_id >= ACTUATOR_NUM_COMMANDS);
+
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    *stats_out = command_stats[cmd_id];
+    restore_interrupts(prev_interrupt);
+}
+
 void actuator_init(void){
     hard_assert_if(LIFETIME_CHECK, actuator_initialized);
 
     status_valid_timeout = get_absolute_time(); // Expire the last status immediately
     actuator_initialized = true;
+    actuator_command_pool_init();
     actuator_populate_command(&status_command, ACTUATOR_CMD_GET_STATUS, actuator_status_callback, false);
     actuator_populate_command(&kill_switch_update_command, ACTUATOR_CMD_KILL_SWITCH, actuator_kill_switch_update_callback, true);
+    // Kill switch updates are safety relevant, so they must not wait behind sensor polling
+    kill_switch_update_command.i2c_request.priority = ASYNC_I2C_PRIORITY_HIGH;
+
     hard_assert(add_alarm_in_ms(ACTUATOR_POLLING_RATE_MS, &actuator_poll_alarm_callback, NULL, true) > 0);
 }
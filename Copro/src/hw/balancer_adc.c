@@ -21,6 +21,7 @@ static void balancer_adc_failure(__unused const struct async_i2c_request * req,
 const struct adc_configuration balancer_adc_config = {
     .i2c = SENSOR_I2C_HW,
     .address = 0x1F,
+    .speed = ASYNC_I2C_SPEED_FAST,
     .poll_rate_ms = 250,
     .enable_temperature = true,
     .external_vref = true,
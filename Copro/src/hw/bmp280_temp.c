@@ -138,6 +138,8 @@ const struct async_i2c_request get_data_req = {
     .bytes_to_receive = 6,
     .completed_callback = get_uncomp_data_cb,
     .failed_callback = get_uncomp_data_fail,
+    .repeated_start = true,
+    .speed = ASYNC_I2C_SPEED_FAST,
 };
 
 bool bmp280_temp_read(double* temp){
@@ -151,6 +153,7 @@ bool bmp280_temp_read(double* temp){
 }
 
 static int64_t bmp280_poll_alarm_cb(__unused alarm_id_t id, __unused void *user_data) {
+    // If the previous poll hasn't finished it is merged, and if the bus is overloaded the poll is skipped until next period
     async_i2c_enqueue(&get_data_req, &in_progress);
 
     return 250 * 1000;
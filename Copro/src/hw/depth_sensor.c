@@ -1,7 +1,12 @@
+#include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include <rmw_microros/rmw_microros.h>
 
 #include "basic_logger/logging.h"
 
@@ -9,15 +14,12 @@
 #include "drivers/safety.h"
 #include "hw/depth_sensor.h"
 #include "hw/depth_sensor_commands.h"
+#include "hw/depth_sensor_math.h"
+#include "tasks/ros.h"
 
 #undef LOGGING_UNIT_NAME
 #define LOGGING_UNIT_NAME "depth_sensor"
 
-/**
- * @brief The polling rate in milliseconds for how often the depth should refresh
- */
-#define DEPTH_POLLING_RATE_MS 50
-
 /**
  * @brief The number of invalid reads from the depth sensor before a fault is raised
  */
@@ -26,8 +28,10 @@
 
 bool depth_initialized = false;
 static bool in_transaction = false;
+static struct async_i2c_script_state sample_script_state;
 
 static void depth_begin_zero_depth(void);
+static void depth_estimator_update(void);
 
 // ========================================
 // Initialization Code
@@ -150,8 +154,38 @@ static int32_t depth_pressure = 0;
 static int32_t depth_temp;
 /**
  * @brief The timeout of the last reading for when it will be invalid
+ * Allows for polls skipped while a previous sample is still running
  */
 static absolute_time_t depth_current_read_timeout = {0};
+/**
+ * @brief The time in us since boot that the last D1 conversion was read
+ */
+static uint64_t depth_sample_time_us = 0;
+/**
+ * @brief The number of pressure samples taken
+ */
+static uint32_t depth_sample_count = 0;
+/**
+ * @brief The number of samples lost to failed reads after initialization
+ */
+static uint32_t depth_failed_sample_count = 0;
+
+/**
+ * @brief If the compensation values have been calculated from a temperature reading
+ */
+static bool depth_compensation_valid = false;
+/**
+ * @brief Temperature compensation values, calculated from the last D2 conversion
+ */
+static struct depth_compensation depth_compensation;
+/**
+ * @brief The number of samples until the temperature is refreshed
+ */
+static int depth_samples_until_temperature = 0;
+/**
+ * @brief If the running sample also refreshes the temperature
+ */
+static bool depth_sampling_temperature = false;
 
 
 // State management varaibles for the active depth reading command
@@ -165,23 +199,11 @@ static bool depth_read_running = false;
  */
 static int depth_read_num_reads_remaining;
 
-/**
- * @brief Boolean for what value the request
- * False: Reading D1 from sensor
- * True: Reading D2 from sensor
- */
-static bool depth_read_reading_d2;
-
 /**
  * @brief Callback for when the current read request has completed all of the requested reads
  */
 static void (*depth_read_finished_cb)(void);
 
-/**
- * @brief Variable to hold the d1 reading from the ADC when reading the D2 value from the sensor
- */
-static uint32_t depth_read_d1_temp;
-
 /**
  * @brief The number of bad reads. Used as a counter before raising a fault for losing depth sensor
  */
@@ -189,117 +211,100 @@ static int depth_num_bad_reads = 0;
 
 
 /**
- * @brief Does calculations with PROM and ADC readings to calculate the pressure and temperature readings
- * Taken from the datasheet (And previous python firmware)
+ * @brief Calculates the temperature and compensation values from the D2 ADC reading
  *
- * @param D1 The ADC reading of the D1 Conversion
  * @param D2 The ADC reading of the D2 Conversion
  */
-static void depth_calculate(uint32_t D1, uint32_t D2) {
-    int64_t OFFi = 0;
-    int64_t SENSi = 0;
-    int Ti = 0;
-
-    int32_t dT = D2-((int32_t)depth_prom[5]) * 256;
-    int64_t SENS = ((int64_t)depth_prom[1]) * 32768 + (((int64_t)depth_prom[3]) * dT)/256;
-    int64_t OFF = ((int64_t)depth_prom[2])*65536+(((int64_t)depth_prom[4])*dT)/128;
-    depth_pressure = (D1*SENS/(2097152)-OFF)/(8192);
-
-    depth_temp = 2000+dT*((int64_t)depth_prom[6])/8388608;
-
-    // Second order compensation
-
-    if ((depth_temp/100) < 20) { // Low temp
-        Ti = (3*dT*dT)/(8589934592);
-        OFFi = (3*(depth_temp-2000)*(depth_temp-2000))/2;
-        SENSi = (5*(depth_temp-2000)*(depth_temp-2000))/8;
-        if ((depth_temp/100) < -15) { // Very low temp
-            OFFi = OFFi+7*(depth_temp+1500)*(depth_temp+1500);
-            SENSi = SENSi+4*(depth_temp+1500)*(depth_temp+1500);
-        }
-    } else if ((depth_temp/100) >= 20) { // High temp
-        Ti = 2*(dT*dT)/(137438953472);
-        OFFi = (1*(depth_temp-2000)*(depth_temp-2000))/16;
-        SENSi = 0;
-    }
-
-    int64_t OFF2 = OFF-OFFi;
-    int64_t SENS2 = SENS-SENSi;
-
-    depth_temp = (depth_temp-Ti);
-    depth_pressure = (((D1*SENS2)/2097152-OFF2)/8192)/10.0;
-    depth_current_read_timeout = make_timeout_time_ms(DEPTH_POLLING_RATE_MS * 2);
-    depth_num_bad_reads = 0;
+static void depth_calculate_temperature(uint32_t D2) {
+    depth_calculate_compensation(depth_prom, D2, &depth_compensation);
+    depth_temp = depth_compensation.temperature;
+    depth_compensation_valid = true;
 }
 
 /**
- * @brief Timer callback to give time for the depth sensor to collect the requested data
+ * @brief Calculates the pressure from the D1 ADC reading using the cached compensation values
  *
- * @param id The ID of the alarm that triggered the callback
- * @param user_data User provided data. This is NULL
- * @return int64_t If/How to restart the timer
+ * @param D1 The ADC reading of the D1 Conversion
+ * @param sample_time_us The time in us since boot that the conversion was read
  */
-static int64_t depth_adc_wait_callback(__unused alarm_id_t id, __unused void *user_data) {
-    async_i2c_enqueue(&adc_read_req, &in_transaction);
-    return 0;
+static void depth_calculate_pressure(uint32_t D1, uint64_t sample_time_us) {
+    depth_pressure = depth_calculate_pressure_mbar(&depth_compensation, D1);
+    depth_sample_time_us = sample_time_us;
+    depth_sample_count++;
+    depth_current_read_timeout = make_timeout_time_ms(DEPTH_POLLING_RATE_MS * 3);
+    depth_num_bad_reads = 0;
+
+    // The estimator can only run once the surface pressure is known
+    if (depth_initialized) {
+        depth_estimator_update();
+    }
 }
 
 /**
- * @brief Callback after the begin conversion request is sent
- *
- * @param req The request which caused the callback
+ * @brief Starts the next sample, refreshing the temperature if it is due
  */
-static void depth_convert_cmd_finished(__unused const struct async_i2c_request *req) {
-    hard_assert(add_alarm_in_ms((int)(2.5e-3 * (1<<(8+DEPTH_OVERSAMPLING))) + 2, &depth_adc_wait_callback, NULL, true) > 0);
+static void depth_start_sample(void) {
+    if (depth_samples_until_temperature == 0 || !depth_compensation_valid) {
+        depth_samples_until_temperature = DEPTH_TEMPERATURE_INTERVAL - 1;
+        depth_sampling_temperature = true;
+        async_i2c_run_script(&depth_full_sample_script, &sample_script_state, &in_transaction);
+    } else {
+        depth_samples_until_temperature--;
+        depth_sampling_temperature = false;
+        async_i2c_run_script(&depth_pressure_sample_script, &sample_script_state, &in_transaction);
+    }
 }
 
 /**
- * @brief Callback after a successful read of the data in the depth sensor's ADC
+ * @brief Callback after the sample script has read D1, and D2 if the temperature was refreshed
  *
- * @param req The request which caused the callback
+ * @param state The script state which caused the callback
  */
-static void depth_adc_read_finished(__unused const struct async_i2c_request *req){
-    if (depth_read_reading_d2) {
-        // Do final processing
-        uint32_t d2 = adc_read_data[0] << 16 | adc_read_data[1] << 8 | adc_read_data[2];
-        depth_calculate(depth_read_d1_temp, d2);
+static void depth_sample_finished(__unused const struct async_i2c_script_state *state) {
+    // The D1 conversion finished just before it was read, so this is the acquisition time of the sample
+    uint64_t sample_time_us = time_us_64();
 
-        depth_read_num_reads_remaining--;
-        if (depth_read_num_reads_remaining) {
-            depth_read_reading_d2 = false;
-            async_i2c_enqueue(&d1_convert_req, &in_transaction);
-        } else {
-            depth_read_running = false;
+    if (depth_sampling_temperature) {
+        uint32_t d2 = d2_read_data[0] << 16 | d2_read_data[1] << 8 | d2_read_data[2];
+        depth_calculate_temperature(d2);
+    }
 
-            if (depth_read_finished_cb) {
-                (*depth_read_finished_cb)();
-            }
-        }
+    uint32_t d1 = d1_read_data[0] << 16 | d1_read_data[1] << 8 | d1_read_data[2];
+    depth_calculate_pressure(d1, sample_time_us);
+
+    depth_read_num_reads_remaining--;
+    if (depth_read_num_reads_remaining) {
+        depth_start_sample();
     } else {
-        depth_read_reading_d2 = true;
-        depth_read_d1_temp = adc_read_data[0] << 16 | adc_read_data[1] << 8 | adc_read_data[2];
-        async_i2c_enqueue(&d2_convert_req, &in_transaction);
+        depth_read_running = false;
+
+        if (depth_read_finished_cb) {
+            (*depth_read_finished_cb)();
+        }
     }
 }
 
 /**
  * @brief Failure callback for read requests from the sensor
  *
- * @param req The request that failed
+ * @param state The script that failed
  * @param abort_data The contents of the abort register
  */
-static void depth_read_failure(__unused const struct async_i2c_request *req, uint32_t abort_data) {
+static void depth_read_failure(__unused const struct async_i2c_script_state *state, uint32_t abort_data) {
     LOG_WARN("Failed to read depth sensor (Tx Abort: %d)", abort_data);
     if (!depth_initialized) {
         // This callback could occur during calibration which would fail to initialize the sensor
         safety_raise_fault(FAULT_DEPTH_INIT_ERROR);
     } else {
+        depth_failed_sample_count++;
         depth_num_bad_reads++;
         if (depth_num_bad_reads >= DEPTH_BAD_READS_FAULT_COUNT){
             safety_raise_fault(FAULT_DEPTH_ERROR);
         }
     }
 
+    // Refresh the temperature on the next sample, as it may have been the temperature conversion that failed
+    depth_samples_until_temperature = 0;
     depth_read_running = false;
 }
 
@@ -317,9 +322,8 @@ static void depth_adc_queue_reads(int num_reads, void (*callback)(void)) {
 
     depth_read_running = true;
     depth_read_num_reads_remaining = num_reads;
-    depth_read_reading_d2 = false;
     depth_read_finished_cb = callback;
-    async_i2c_enqueue(&d1_convert_req, &in_transaction);
+    depth_start_sample();
 }
 
 /**
@@ -330,52 +334,222 @@ static void depth_adc_queue_reads(int num_reads, void (*callback)(void)) {
  * @return int64_t If/How to restart the timer
  */
 static int64_t depth_read_alarm_callback(__unused alarm_id_t id, __unused void *user_data) {
-    if (depth_read_running) {
-        LOG_ERROR("Depth new transaction started with one still in progress");
-        safety_raise_fault(FAULT_DEPTH_ERROR);
-    } else {
+    // A read can overrun the poll from a temperature refresh, bus contention or retries, so that poll is skipped
+    // A read which never finishes is caught by the i2c timeout, and a stale depth by depth_reading_valid
+    if (!depth_read_running) {
         depth_adc_queue_reads(1, NULL);
     }
 
     return DEPTH_POLLING_RATE_MS * 1000;
 }
 
+// ========================================
+// Fluid Parameters
+// ========================================
+
+/**
+ * @brief The default fluid density in tenths of kg/m^3 (Fresh water)
+ */
+#define DEPTH_DEFAULT_FLUID_DENSITY 9970
+/**
+ * @brief The default gravity in 1e-5 m/s^2 (Standard gravity)
+ */
+#define DEPTH_DEFAULT_GRAVITY 980665
+
+// Limits of the accepted fluid parameters, in the same units as the defaults
+#define DEPTH_MIN_FLUID_DENSITY 9000
+#define DEPTH_MAX_FLUID_DENSITY 11000
+#define DEPTH_MIN_GRAVITY 975000
+#define DEPTH_MAX_GRAVITY 985000
+
+/**
+ * @brief Gravity is persisted as an offset from this value so that both parameters fit in one watchdog register
+ */
+#define DEPTH_GRAVITY_PERSIST_OFFSET 970000
+
+/**
+ * @brief The fluid density in tenths of kg/m^3
+ */
+static uint32_t depth_fluid_density = DEPTH_DEFAULT_FLUID_DENSITY;
+/**
+ * @brief The gravity in 1e-5 m/s^2
+ */
+static uint32_t depth_gravity = DEPTH_DEFAULT_GRAVITY;
+
+/**
+ * @brief The depth conversion for the fluid parameters
+ */
+static struct depth_conversion depth_conversion;
+
+/**
+ * @brief Sets the fluid parameters, recalculating the depth conversion and saving them in the watchdog registers
+ *
+ * @param density The fluid density in tenths of kg/m^3
+ * @param gravity The gravity in 1e-5 m/s^2
+ */
+static void depth_set_fluid_parameters(uint32_t density, uint32_t gravity) {
+    struct depth_conversion conversion;
+    depth_calculate_conversion(density, gravity, &conversion);
+
+    // The conversion is used from the i2c interrupt, so it must be updated atomically
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    depth_fluid_density = density;
+    depth_gravity = gravity;
+    depth_conversion = conversion;
+    restore_interrupts(prev_interrupt);
+
+    *depth_fluid_reg = (density << 16) | (gravity - DEPTH_GRAVITY_PERSIST_OFFSET);
+}
+
+/**
+ * @brief Loads the fluid parameters saved in the watchdog registers, or the defaults if none are saved
+ */
+static void depth_load_fluid_parameters(void) {
+    uint32_t saved = *depth_fluid_reg;
+    uint32_t density = saved >> 16;
+    uint32_t gravity = (saved & 0xFFFF) + DEPTH_GRAVITY_PERSIST_OFFSET;
+
+    if (saved != DEPTH_FLUID_INVALID &&
+            density >= DEPTH_MIN_FLUID_DENSITY && density <= DEPTH_MAX_FLUID_DENSITY &&
+            gravity >= DEPTH_MIN_GRAVITY && gravity <= DEPTH_MAX_GRAVITY) {
+        LOG_INFO("Depth fluid parameters found... Using saved density and gravity");
+        depth_set_fluid_parameters(density, gravity);
+    } else {
+        depth_set_fluid_parameters(DEPTH_DEFAULT_FLUID_DENSITY, DEPTH_DEFAULT_GRAVITY);
+    }
+}
+
 // ========================================
 // Calibration Code
 // ========================================
 
-#define FLUID_DENSITY 997
 /**
- * @brief The surface pressure in tens of mbar
+ * @brief The number of reads discarded before zeroing while the sensor settles
+ */
+#define DEPTH_ZERO_WARMUP_READS 4
+/**
+ * @brief A zero saved in flash is reused on a cold boot if the first sample is within this many mbar of it
+ * There is no clock at boot to check the age of the zero against, so any saved zero within the tolerance is reused
+ */
+#define DEPTH_ZERO_REUSE_TOLERANCE_MBAR 3
+
+/**
+ * @brief The surface pressure in mbar
  * Generated during calibration
  */
 static int32_t surface_pressure;
 
 /**
- * @brief The number of times a zero reading has been added
+ * @brief The samples taken so far during zeroing
+ */
+static struct depth_zero_samples zero_samples;
+
+/**
+ * @brief If a valid zero was loaded from flash that can be reused if the sensor is still at the same pressure
+ */
+static bool zero_flash_valid = false;
+
+/**
+ * @brief If the surface pressure needs to be saved to flash on the next depth_tick
+ * Flash cannot be written from the interrupt the zeroing runs in
  */
-static int zero_count;
+static bool zero_flash_save_pending = false;
+
+/**
+ * @brief The calibration record saved in the reserved flash sector
+ */
+struct depth_flash_calibration {
+    uint32_t magic;
+    int32_t surface_pressure;
+    // Inverted copy of surface_pressure to detect a corrupted record
+    uint32_t surface_pressure_inv;
+    uint32_t reserved;
+    // ROS epoch time in ms when the zero was taken, or 0 if the time was not known. Only logged
+    uint64_t timestamp_ms;
+};
+#define DEPTH_FLASH_CALIBRATION_MAGIC 0x44455054
+
+/**
+ * @brief The watchdog timeout in ms while the calibration sector is rewritten
+ * The W25Q16JV takes 45 ms typical and 400 ms max to erase a sector, and 3 ms max to program a page
+ */
+#define DEPTH_FLASH_WRITE_WATCHDOG_MS 600
+
+static_assert(sizeof(struct depth_flash_calibration) <= FLASH_PAGE_SIZE, "Depth calibration must fit in one flash page");
+
+/**
+ * @brief The flash sector reserved for the calibration record
+ * Allocated in the image so the linker keeps the program out of it. Flashing new firmware erases the record
+ */
+static const uint8_t __in_flash("depth_calibration") __attribute__((aligned(FLASH_SECTOR_SIZE)))
+    depth_flash_calibration_sector[FLASH_SECTOR_SIZE] = {[0 ... FLASH_SECTOR_SIZE - 1] = 0xFF};
+#define DEPTH_CAL_FLASH_OFFSET ((uintptr_t) depth_flash_calibration_sector - XIP_BASE)
+
+// Read through volatile, as the compiler would otherwise assume the sector still holds its initial contents
+static const volatile struct depth_flash_calibration *const depth_flash_calibration_data =
+    (const volatile struct depth_flash_calibration *) depth_flash_calibration_sector;
+
+/**
+ * @brief Checks if the calibration record in flash is valid
+ *
+ * @return true The record in flash can be used
+ */
+static bool depth_flash_calibration_valid(void) {
+    return depth_flash_calibration_data->magic == DEPTH_FLASH_CALIBRATION_MAGIC &&
+            depth_flash_calibration_data->surface_pressure_inv == ~((uint32_t) depth_flash_calibration_data->surface_pressure);
+}
+
+/**
+ * @brief Finishes zeroing with the provided surface pressure and starts the read task
+ *
+ * @param pressure The surface pressure in mbar
+ * @param save_to_flash If the surface pressure should be saved to flash to be reused on a cold boot
+ */
+static void depth_finish_zero_depth(int32_t pressure, bool save_to_flash) {
+    surface_pressure = pressure;
+
+    // Save surface pressure in watchdog in case of crash while submerged
+    *depth_cal_reg = (uint32_t)surface_pressure;
+    zero_flash_save_pending = save_to_flash;
+
+    depth_initialized = true;
+    hard_assert(add_alarm_in_ms(DEPTH_POLLING_RATE_MS, &depth_read_alarm_callback, NULL, true) > 0);
+}
 
 /**
  * @brief Callback after a succesful reading signaling to update zeroing
  */
 static void depth_zero_depth(void) {
-    if (zero_count == 1) {
-        surface_pressure = depth_pressure;
+    if (zero_samples.count == 0 && zero_flash_valid) {
+        int32_t saved_pressure = depth_flash_calibration_data->surface_pressure;
+        int32_t diff = depth_pressure - saved_pressure;
+        if (diff <= DEPTH_ZERO_REUSE_TOLERANCE_MBAR && diff >= -DEPTH_ZERO_REUSE_TOLERANCE_MBAR) {
+            LOG_INFO("Depth surface pressure in flash matches current pressure... Reusing zero taken at %llu ms",
+                    depth_flash_calibration_data->timestamp_ms);
+            depth_finish_zero_depth(saved_pressure, false);
+            return;
+        }
     }
-    else if (zero_count > 1) {
-        surface_pressure = surface_pressure * .7 + depth_pressure * .3;
+
+    int32_t pressure;
+    enum depth_zero_result result = depth_zero_add_sample(&zero_samples, depth_pressure, &pressure);
+    if (result == DEPTH_ZERO_NEEDS_SAMPLES) {
+        depth_adc_queue_reads(1, &depth_zero_depth);
+        return;
     }
-    zero_count++;
-    if (zero_count < 20) {
-        depth_adc_queue_reads(2, &depth_zero_depth);
-    } else {
-        // Save surface pressure in watchdog in case of crash while submerged
-        *depth_cal_reg = (uint32_t)surface_pressure;
 
-        depth_initialized = true;
-        hard_assert(add_alarm_in_ms(DEPTH_POLLING_RATE_MS, &depth_read_alarm_callback, NULL, true) > 0);
+    if (result == DEPTH_ZERO_NOT_CONVERGED) {
+        LOG_WARN("Depth zeroing did not converge after %d samples", zero_samples.count);
     }
+    depth_finish_zero_depth(pressure, true);
+}
+
+/**
+ * @brief Callback after the warmup reads to begin collecting samples for zeroing
+ */
+static void depth_zero_warmup_finished(void) {
+    zero_samples.count = 0;
+    depth_adc_queue_reads(1, &depth_zero_depth);
 }
 
 /**
@@ -384,26 +558,61 @@ static void depth_zero_depth(void) {
  */
 static void depth_begin_zero_depth(void) {
     if (*depth_cal_reg == DEPTH_CALIBRATION_INVALID) {
-        zero_count = 0;
-        depth_adc_queue_reads(20, &depth_zero_depth);
+        zero_flash_valid = depth_flash_calibration_valid();
+        depth_adc_queue_reads(DEPTH_ZERO_WARMUP_READS, &depth_zero_warmup_finished);
     } else {
         LOG_INFO("Depth surface pressure found... Skipping Zeroing of Depth");
-        surface_pressure = (int32_t)*depth_cal_reg;
 
         // Start depth sensor read task
-        depth_initialized = true;
-        hard_assert(add_alarm_in_ms(DEPTH_POLLING_RATE_MS, &depth_read_alarm_callback, NULL, true) > 0);
+        depth_finish_zero_depth((int32_t)*depth_cal_reg, false);
     }
 }
 
+// ========================================
+// Depth Estimator
+// ========================================
+
+/**
+ * @brief The alpha-beta filter state, updated from the i2c interrupt
+ */
+static struct depth_estimator depth_estimator = {.running = false};
+
+/**
+ * @brief Runs the estimator with the latest depth reading
+ */
+static void depth_estimator_update(void) {
+    depth_estimator_step(&depth_estimator, depth_read_mm(), depth_sample_time_us);
+}
+
 // ========================================
 // Public Functions
 // ========================================
 
+int32_t depth_read_mm(void) {
+    hard_assert_if(DEPTH, !depth_initialized);
+
+    return depth_pressure_to_mm(&depth_conversion, depth_pressure - surface_pressure);
+}
+
 double depth_read(void) {
+    return depth_read_mm() / 1000.0;
+}
+
+void depth_get_estimate(struct depth_estimate *estimate) {
     hard_assert_if(DEPTH, !depth_initialized);
 
-    return ((depth_pressure - surface_pressure)*100)/(FLUID_DENSITY*9.80665);
+    // The estimator runs from the i2c interrupt, so copy the state atomically
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    struct depth_estimator estimator = depth_estimator;
+    uint32_t sample_count = depth_sample_count;
+    restore_interrupts(prev_interrupt);
+
+    depth_estimator_get(&estimator, estimate);
+    estimate->sample_count = sample_count;
+}
+
+uint32_t depth_get_failed_sample_count(void) {
+    return depth_failed_sample_count;
 }
 
 bool depth_reading_valid(void) {
@@ -415,6 +624,94 @@ float depth_get_temperature(void) {
     return depth_temp / 100.0;
 }
 
+rcl_ret_t depth_create_parameters(rclc_parameter_server_t *param_server) {
+    RC_RETURN_CHECK(rclc_add_parameter(param_server, "depth_fluid_density", RCLC_PARAMETER_DOUBLE));
+    RC_RETURN_CHECK(rclc_add_parameter(param_server, "depth_gravity", RCLC_PARAMETER_DOUBLE));
+
+    // Report the values in use, which may have been restored after a watchdog reset
+    RC_RETURN_CHECK(rclc_parameter_set_double(param_server, "depth_fluid_density", depth_fluid_density / 10.0));
+    RC_RETURN_CHECK(rclc_parameter_set_double(param_server, "depth_gravity", depth_gravity / 100000.0));
+
+    return RCL_RET_OK;
+}
+
+bool depth_handle_parameter_change(Parameter * param) {
+    if (param->value.type != RCLC_PARAMETER_DOUBLE) {
+        return false;
+    }
+
+    if (!strcmp(param->name.data, "depth_fluid_density")) {
+        double density = round(param->value.double_value * 10);
+        if (density >= DEPTH_MIN_FLUID_DENSITY && density <= DEPTH_MAX_FLUID_DENSITY) {
+            depth_set_fluid_parameters((uint32_t) density, depth_gravity);
+            return true;
+        } else {
+            return false;
+        }
+    } else if (!strcmp(param->name.data, "depth_gravity")) {
+        double gravity = round(param->value.double_value * 100000);
+        if (gravity >= DEPTH_MIN_GRAVITY && gravity <= DEPTH_MAX_GRAVITY) {
+            depth_set_fluid_parameters(depth_fluid_density, (uint32_t) gravity);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+void depth_tick(void) {
+    if (!zero_flash_save_pending) {
+        return;
+    }
+
+    // Re-zeroing at the same pressure doesn't need to wear the sector
+    if (depth_flash_calibration_valid() && depth_flash_calibration_data->surface_pressure == surface_pressure) {
+        zero_flash_save_pending = false;
+        return;
+    }
+
+    // Only the first bytes of the page are used, the rest is left erased
+    static uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    struct depth_flash_calibration *calibration = (struct depth_flash_calibration *) page;
+    calibration->magic = DEPTH_FLASH_CALIBRATION_MAGIC;
+    calibration->surface_pressure = surface_pressure;
+    calibration->surface_pressure_inv = ~((uint32_t) surface_pressure);
+    calibration->reserved = 0;
+    calibration->timestamp_ms = (rmw_uros_epoch_synchronized() ? rmw_uros_epoch_millis() : 0);
+
+    // Execution from flash stops during the erase, so interrupts must be disabled for its duration
+    // This stalls i2c, usb and kill switch handling, so the write waits until the robot is killed
+    if (!safety_initialized || !safety_kill_get_asserting_kill()) {
+        return;
+    }
+
+    // Any transaction running through the erase would stall or time out, so the write waits for a tick where the buses are idle
+    uint32_t prev_interrupt = save_and_disable_interrupts();
+    if (depth_read_running) {
+        restore_interrupts(prev_interrupt);
+        return;
+    }
+    for (uint i = 0; i < NUM_I2CS; i++) {
+        if (!async_i2c_bus_idle(i2c_get_instance(i))) {
+            restore_interrupts(prev_interrupt);
+            return;
+        }
+    }
+    zero_flash_save_pending = false;
+
+    // The worst case erase is longer than the watchdog timeout during operation
+    safety_extend_watchdog(DEPTH_FLASH_WRITE_WATCHDOG_MS);
+    flash_range_erase(DEPTH_CAL_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(DEPTH_CAL_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(prev_interrupt);
+
+    LOG_INFO("Saved depth surface pressure to flash");
+}
+
 void depth_init(void) {
+    depth_load_fluid_parameters();
     async_i2c_enqueue(&reset_req, &in_transaction);
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hw/depth_sensor_math.h"
+
+// ========================================
+// Compensation
+// ========================================
+
+void depth_calculate_compensation(const uint16_t prom[8], uint32_t D2, struct depth_compensation *compensation) {
+    int64_t OFFi = 0;
+    int64_t SENSi = 0;
+    int Ti = 0;
+
+    int32_t dT = D2-((int32_t)prom[5]) * 256;
+    int64_t SENS = ((int64_t)prom[1]) * 32768 + (((int64_t)prom[3]) * dT)/256;
+    int64_t OFF = ((int64_t)prom[2])*65536+(((int64_t)prom[4])*dT)/128;
+
+    int32_t temp = 2000+dT*((int64_t)prom[6])/8388608;
+
+    // Second order compensation
+
+    if ((temp/100) < 20) { // Low temp
+        Ti = (3*dT*dT)/(8589934592);
+        OFFi = (3*(temp-2000)*(temp-2000))/2;
+        SENSi = (5*(temp-2000)*(temp-2000))/8;
+        if ((temp/100) < -15) { // Very low temp
+            OFFi = OFFi+7*(temp+1500)*(temp+1500);
+            SENSi = SENSi+4*(temp+1500)*(temp+1500);
+        }
+    } else if ((temp/100) >= 20) { // High temp
+        Ti = 2*(dT*dT)/(137438953472);
+        OFFi = (1*(temp-2000)*(temp-2000))/16;
+        SENSi = 0;
+    }
+
+    compensation->off2 = OFF-OFFi;
+    compensation->sens2 = SENS-SENSi;
+    compensation->temperature = (temp-Ti);
+}
+
+/**
+ * @brief Divides by a power of two, rounding towards zero to match integer division
+ * The M0+ has no 64-bit divide, so this avoids the library call for the divides in the datasheet calculations
+ *
+ * @param value The value to divide
+ * @param shift The power of two to divide by
+ * @return int64_t value / (1 << shift)
+ */
+static inline int64_t depth_div_pow2(int64_t value, unsigned int shift) {
+    return (value < 0 ? -((-value) >> shift) : (value >> shift));
+}
+
+int32_t depth_calculate_pressure_mbar(const struct depth_compensation *compensation, uint32_t D1) {
+    int64_t pressure_tenth_mbar = depth_div_pow2(depth_div_pow2(((int64_t) D1) * compensation->sens2, 21) - compensation->off2, 13);
+    return ((int32_t) pressure_tenth_mbar) / 10;
+}
+
+// ========================================
+// Depth Conversion
+// ========================================
+
+void depth_calculate_conversion(uint32_t density, uint32_t gravity, struct depth_conversion *conversion) {
+    // In these units, mm per mbar = 1e11 / (density * gravity)
+    uint64_t divisor = ((uint64_t) density) * gravity;
+    uint64_t remainder = 100000000000ull;
+    uint32_t mm_per_mbar_int = remainder / divisor;
+
+    // The divisor is wider than 32 bits, so the fraction is found 16 bits at a time to keep the remainder from overflowing
+    uint64_t mm_per_mbar_frac = 0;
+    for (int i = 0; i < 4; i++) {
+        remainder = (remainder % divisor) << 16;
+        mm_per_mbar_frac = (mm_per_mbar_frac << 16) | (remainder / divisor);
+    }
+
+    // Rounded up so that depths which are exactly a whole mm aren't truncated to the mm below. The error this adds is
+    // below 1 / (density * gravity), the closest a depth which isn't a whole mm can be to the next one, so truncation stays exact
+    if (remainder % divisor != 0) {
+        mm_per_mbar_frac++;
+        if (mm_per_mbar_frac == 0) {
+            mm_per_mbar_int++;
+        }
+    }
+
+    conversion->mm_per_mbar_int = mm_per_mbar_int;
+    conversion->mm_per_mbar_frac = mm_per_mbar_frac;
+}
+
+int32_t depth_pressure_to_mm(const struct depth_conversion *conversion, int32_t pressure_diff) {
+    uint32_t abs_diff = (pressure_diff < 0 ? -pressure_diff : pressure_diff);
+
+    // The top 32 bits of the 96-bit product of the difference and the fraction, from two 32x32 multiplies
+    uint32_t frac_high = conversion->mm_per_mbar_frac >> 32;
+    uint32_t frac_low = (uint32_t) conversion->mm_per_mbar_frac;
+    uint64_t frac_product = ((uint64_t) abs_diff) * frac_high + ((((uint64_t) abs_diff) * frac_low) >> 32);
+    int32_t depth_mm = abs_diff * conversion->mm_per_mbar_int + (uint32_t)(frac_product >> 32);
+
+    return (pressure_diff < 0 ? -depth_mm : depth_mm);
+}
+
+// ========================================
+// Zeroing
+// ========================================
+
+enum depth_zero_result depth_zero_add_sample(struct depth_zero_samples *zero, int32_t pressure, int32_t *surface_pressure) {
+    // Insertion sort so the median can be found
+    int i = zero->count;
+    while (i > 0 && zero->samples[i - 1] > pressure) {
+        zero->samples[i] = zero->samples[i - 1];
+        i--;
+    }
+    zero->samples[i] = pressure;
+    zero->count++;
+
+    if (zero->count < DEPTH_ZERO_MIN_SAMPLES) {
+        return DEPTH_ZERO_NEEDS_SAMPLES;
+    }
+
+    // Accumulate the accepted samples relative to the median to keep the sums small
+    int32_t median = zero->samples[zero->count / 2];
+    int32_t sum = 0;
+    int32_t sum_sq = 0;
+    int32_t accepted = 0;
+    for (i = 0; i < zero->count; i++) {
+        int32_t diff = zero->samples[i] - median;
+        if (diff <= DEPTH_ZERO_OUTLIER_MBAR && diff >= -DEPTH_ZERO_OUTLIER_MBAR) {
+            sum += diff;
+            sum_sq += diff * diff;
+            accepted++;
+        }
+    }
+
+    // accepted^2 * variance = accepted * sum_sq - sum^2, which avoids dividing
+    bool converged = (accepted >= DEPTH_ZERO_MIN_SAMPLES &&
+            (accepted * sum_sq - sum * sum) <= DEPTH_ZERO_CONVERGED_VARIANCE * accepted * accepted);
+
+    if (!converged && zero->count < DEPTH_ZERO_MAX_SAMPLES) {
+        return DEPTH_ZERO_NEEDS_SAMPLES;
+    }
+
+    int32_t rounding = (sum < 0 ? -(accepted / 2) : (accepted / 2));
+    *surface_pressure = median + (sum + rounding) / accepted;
+    return (converged ? DEPTH_ZERO_CONVERGED : DEPTH_ZERO_NOT_CONVERGED);
+}
+
+// ========================================
+// Depth Estimator
+// ========================================
+
+/**
+ * @brief Fractional bits used for the estimator state
+ */
+#define DEPTH_ESTIMATOR_FRAC_BITS 8
+
+/**
+ * @brief Position and velocity gains of the alpha-beta filter in Q16
+ * Alpha is 0.4, with beta = 2 * (2 - alpha) - 4 * sqrt(1 - alpha) = 0.1016 from the Kalata relation, which makes the
+ * filter the steady state Kalman filter for a constant velocity target with white acceleration noise
+ */
+#define DEPTH_ESTIMATOR_ALPHA_Q16 26214
+#define DEPTH_ESTIMATOR_BETA_Q16 6659
+
+/**
+ * @brief Steady state gains from the residual variance to the depth and velocity variance in Q16
+ * With the Kalata beta, the steady state Kalman covariance gives depth variance alpha * (1 - alpha) * S = 0.24 * S
+ * and velocity variance beta * (2 * alpha - beta) / 2 * S / T^2 = 0.0355 * S / T^2,
+ * where S is the variance of the residual and T is the sample period
+ */
+#define DEPTH_ESTIMATOR_DEPTH_VAR_GAIN_Q16 ((DEPTH_ESTIMATOR_ALPHA_Q16 * (65536 - DEPTH_ESTIMATOR_ALPHA_Q16)) >> 16)
+#define DEPTH_ESTIMATOR_VEL_VAR_GAIN_Q16 ((DEPTH_ESTIMATOR_BETA_Q16 * (2 * DEPTH_ESTIMATOR_ALPHA_Q16 - DEPTH_ESTIMATOR_BETA_Q16)) >> 17)
+
+/**
+ * @brief The residual variance is averaged with a weight of 1/(1 << DEPTH_ESTIMATOR_VARIANCE_SHIFT) for each sample
+ */
+#define DEPTH_ESTIMATOR_VARIANCE_SHIFT 4
+
+/**
+ * @brief The minimum residual variance in mm^2. Readings are quantized to 1 mbar (~10 mm), so the variance is never below this
+ */
+#define DEPTH_ESTIMATOR_MIN_RESIDUAL_VARIANCE_MM2 9
+
+/**
+ * @brief The longest gap between samples before the estimator is restarted from the next sample
+ */
+#define DEPTH_ESTIMATOR_MAX_GAP_US (DEPTH_POLLING_RATE_MS * 1000 * 8)
+
+void depth_estimator_step(struct depth_estimator *estimator, int32_t depth_mm, uint64_t sample_time_us) {
+    int32_t measurement = depth_mm << DEPTH_ESTIMATOR_FRAC_BITS;
+    uint64_t elapsed_us = sample_time_us - estimator->last_update_us;
+
+    if (!estimator->running || elapsed_us > DEPTH_ESTIMATOR_MAX_GAP_US) {
+        estimator->depth = measurement;
+        estimator->velocity = 0;
+        estimator->residual_variance = DEPTH_ESTIMATOR_MIN_RESIDUAL_VARIANCE_MM2;
+        estimator->last_update_us = sample_time_us;
+        estimator->running = true;
+        return;
+    }
+
+    int32_t steps = (((int32_t) elapsed_us) + (DEPTH_POLLING_RATE_MS * 500)) / (DEPTH_POLLING_RATE_MS * 1000);
+    if (steps < 1) {
+        steps = 1;
+    }
+
+    int32_t predicted = estimator->depth + estimator->velocity * steps;
+    int32_t residual = measurement - predicted;
+
+    estimator->depth = predicted + (int32_t)((((int64_t) residual) * DEPTH_ESTIMATOR_ALPHA_Q16) >> 16);
+    estimator->velocity += (int32_t)((((int64_t) residual) * DEPTH_ESTIMATOR_BETA_Q16) >> 16) / steps;
+    estimator->last_update_us = sample_time_us;
+
+    // Squared as unsigned, since the square of a clamped residual above 46340 mm overflows an int32
+    int32_t residual_mm = residual >> DEPTH_ESTIMATOR_FRAC_BITS;
+    uint32_t residual_mag_mm = (residual_mm < 0 ? -(uint32_t) residual_mm : (uint32_t) residual_mm);
+    if (residual_mag_mm > 0xFFFF) {
+        residual_mag_mm = 0xFFFF;
+    }
+    uint32_t residual_sq = residual_mag_mm * residual_mag_mm;
+    if (residual_sq > estimator->residual_variance) {
+        estimator->residual_variance += (residual_sq - estimator->residual_variance) >> DEPTH_ESTIMATOR_VARIANCE_SHIFT;
+    } else {
+        estimator->residual_variance -= (estimator->residual_variance - residual_sq) >> DEPTH_ESTIMATOR_VARIANCE_SHIFT;
+    }
+    if (estimator->residual_variance < DEPTH_ESTIMATOR_MIN_RESIDUAL_VARIANCE_MM2) {
+        estimator->residual_variance = DEPTH_ESTIMATOR_MIN_RESIDUAL_VARIANCE_MM2;
+    }
+}
+
+void depth_estimator_get(const struct depth_estimator *estimator, struct depth_estimate *estimate) {
+    const int32_t samples_per_sec = 1000 / DEPTH_POLLING_RATE_MS;
+    estimate->depth_mm = estimator->depth >> DEPTH_ESTIMATOR_FRAC_BITS;
+    estimate->velocity_mm_s = (estimator->velocity * samples_per_sec) >> DEPTH_ESTIMATOR_FRAC_BITS;
+    estimate->depth_variance_mm2 = (((uint64_t) estimator->residual_variance) * DEPTH_ESTIMATOR_DEPTH_VAR_GAIN_Q16) >> 16;
+    estimate->velocity_variance_mm2_s2 = ((((uint64_t) estimator->residual_variance) * DEPTH_ESTIMATOR_VEL_VAR_GAIN_Q16) * (samples_per_sec * samples_per_sec)) >> 16;
+    estimate->sample_time_us = estimator->last_update_us;
+}
@@ -21,6 +21,7 @@ static void esc_adc_failure(__unused const struct async_i2c_request * req, uint3
 const struct adc_configuration esc_adc_config = {
     .i2c = BOARD_I2C_HW,
     .address = 0x2F,
+    .speed = ASYNC_I2C_SPEED_FAST,
     .poll_rate_ms = 250,
     .enable_temperature = false,
     .external_vref = true,
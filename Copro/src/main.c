@@ -72,6 +72,7 @@ int main()
     {
         safety_tick();
         ros_spin_ms(30);
+        depth_tick();
         //cooling_tick();
         //lowbatt_tick();
     }
@@ -1,3 +1,6 @@
+#include <stdarg.h>
+#include <stdio.h>
+
 #include "pico/stdlib.h"
 #include <hardware/watchdog.h>
 
@@ -19,11 +22,14 @@
 #include <riptide_msgs2/msg/pwm_stamped.h>
 #include <riptide_msgs2/msg/robot_state.h>
 #include <std_msgs/msg/empty.h>
+#include <geometry_msgs/msg/twist_with_covariance_stamped.h>
+#include <diagnostic_msgs/msg/diagnostic_array.h>
 
 #include "basic_logger/logging.h"
 #include "build_version.h"
 #include "pico_uart_transports.h"
 
+#include "drivers/async_i2c.h"
 #include "drivers/memmonitor.h"
 #include "drivers/safety.h"
 #include "hw/actuator.h"
@@ -54,20 +60,43 @@ static void nanos_to_timespec(int64_t time_nanos, struct timespec *ts) {
 static rcl_publisher_t depth_publisher;
 static riptide_msgs2__msg__Depth depth_msg;
 static rcl_timer_t depth_publisher_timer;
+static rcl_publisher_t depth_velocity_publisher;
+static geometry_msgs__msg__TwistWithCovarianceStamped depth_velocity_msg;
 static char depth_frame[] = ROBOT_NAMESPACE "/pressure_link";
-static const float depth_variance = 0.003;  					// TODO: Load from config file or something
 static const int depth_publish_rate_ms = 50;
+static const int depth_velocity_z_covariance_index = 14;		// Row-major index of (z, z) in the 6x6 covariance
+static uint32_t depth_last_sample_count = 0;
+static uint32_t depth_stale_count = 0;
+static uint64_t depth_last_sample_age_us = 0;
 
 static void depth_publisher_timer_callback(rcl_timer_t * timer, __unused int64_t last_call_time) {
 	if (timer != NULL && depth_reading_valid()) {
+		struct depth_estimate estimate;
+		depth_get_estimate(&estimate);
+
+		if (estimate.sample_count == depth_last_sample_count) {
+			// No new sample since the last publish, so don't publish the same reading twice
+			depth_stale_count++;
+			return;
+		}
+		depth_last_sample_count = estimate.sample_count;
 
+		// Stamp with the acquisition time of the sample, converted to the synchronized epoch
+		depth_last_sample_age_us = time_us_64() - estimate.sample_time_us;
 		struct timespec ts;
-		nanos_to_timespec(rmw_uros_epoch_nanos(), &ts);
+		nanos_to_timespec(rmw_uros_epoch_nanos() - ((int64_t) depth_last_sample_age_us) * 1000, &ts);
 		depth_msg.header.stamp.sec = ts.tv_sec;
 		depth_msg.header.stamp.nanosec = ts.tv_nsec;
 
-		depth_msg.depth = -depth_read();
+		depth_msg.depth = -estimate.depth_mm / 1000.0f;
+		depth_msg.variance = estimate.depth_variance_mm2 / 1000000.0f;
 		RCSOFTCHECK(rcl_publish(&depth_publisher, &depth_msg, NULL));
+
+		// Depth is positive downwards, while z is positive upwards
+		depth_velocity_msg.header.stamp = depth_msg.header.stamp;
+		depth_velocity_msg.twist.twist.linear.z = -estimate.velocity_mm_s / 1000.0;
+		depth_velocity_msg.twist.covariance[depth_velocity_z_covariance_index] = estimate.velocity_variance_mm2_s2 / 1000000.0;
+		RCSOFTCHECK(rcl_publish(&depth_velocity_publisher, &depth_velocity_msg, NULL));
 	}
 }
 
@@ -79,6 +108,13 @@ static void depth_publisher_init(rclc_support_t *support, rcl_node_t *node, rclc
 		"depth/raw",
 		&rmw_qos_profile_sensor_data));
 
+	RCCHECK(rclc_publisher_init(
+		&depth_velocity_publisher,
+		node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(geometry_msgs, msg, TwistWithCovarianceStamped),
+		"depth/velocity",
+		&rmw_qos_profile_sensor_data));
+
 	RCCHECK(rclc_timer_init_default(
 		&depth_publisher_timer,
 		support,
@@ -90,11 +126,12 @@ static void depth_publisher_init(rclc_support_t *support, rcl_node_t *node, rclc
 	depth_msg.header.frame_id.data = depth_frame;
 	depth_msg.header.frame_id.capacity = sizeof(depth_frame);
 	depth_msg.header.frame_id.size = strlen(depth_frame);
-	depth_msg.variance = depth_variance;
+	depth_velocity_msg.header.frame_id = depth_msg.header.frame_id;
 }
 
 static void depth_publisher_cleanup(rcl_node_t *node) {
 	RCCHECK(rcl_publisher_fini(&depth_publisher, node));
+	RCCHECK(rcl_publisher_fini(&depth_velocity_publisher, node));
 	RCCHECK(rcl_timer_fini(&depth_publisher_timer));
 }
 
@@ -368,6 +405,333 @@ static void state_publish_cleanup(rcl_node_t *node) {
 	RCCHECK(rcl_timer_fini(&state_publish_timer));
 }
 
+// ========================================
+// I2C Diagnostics
+// ========================================
+
+#define I2C_DIAG_NUM_BUS_VALUES 9
+#define I2C_DIAG_NUM_VALUES (I2C_DIAG_NUM_BUS_VALUES + ASYNC_I2C_MAX_TRACKED_ADDRESSES)
+#define I2C_DIAG_KEY_LEN 24
+#define I2C_DIAG_VALUE_LEN 96
+#define I2C_DIAG_NAME_LEN 16
+#define I2C_DIAG_WARN_UTILIZATION_PCT 80
+#define I2C_DIAG_NUM_DEPTH_VALUES 4
+#define I2C_DIAG_DEPTH_STATUS NUM_I2CS
+#define I2C_DIAG_ACTUATOR_STATUS (NUM_I2CS + 1)
+#define I2C_DIAG_NUM_STATUSES (NUM_I2CS + 2)
+
+static rcl_publisher_t i2c_diagnostics_publisher;
+static diagnostic_msgs__msg__DiagnosticArray i2c_diagnostics_msg;
+static rcl_timer_t i2c_diagnostics_timer;
+// Every status is published once per period. The statuses are sent one per message so each stays well inside the
+// reliable stream buffer, as the full array is several KB
+static const int i2c_diagnostics_publish_rate_ms = 1000;
+static int i2c_diagnostics_next_status = 0;
+static char i2c_diagnostics_hardware_id[] = "coprocessor";
+
+static diagnostic_msgs__msg__DiagnosticStatus i2c_diagnostics_status[I2C_DIAG_NUM_STATUSES];
+static diagnostic_msgs__msg__KeyValue i2c_diagnostics_values[NUM_I2CS][I2C_DIAG_NUM_VALUES];
+static char i2c_diagnostics_names[NUM_I2CS][I2C_DIAG_NAME_LEN];
+static char i2c_diagnostics_keys[NUM_I2CS][I2C_DIAG_NUM_VALUES][I2C_DIAG_KEY_LEN];
+static char i2c_diagnostics_value_strs[NUM_I2CS][I2C_DIAG_NUM_VALUES][I2C_DIAG_VALUE_LEN];
+static char i2c_diagnostics_ok_str[] = "OK";
+static char i2c_diagnostics_high_utilization_str[] = "Bus utilization high";
+
+// The depth sensor reports its dropped and stale samples alongside the bus it is on
+static diagnostic_msgs__msg__KeyValue depth_diagnostics_values[I2C_DIAG_NUM_DEPTH_VALUES];
+static char depth_diagnostics_name[] = "depth";
+static char depth_diagnostics_keys[I2C_DIAG_NUM_DEPTH_VALUES][I2C_DIAG_KEY_LEN];
+static char depth_diagnostics_value_strs[I2C_DIAG_NUM_DEPTH_VALUES][I2C_DIAG_VALUE_LEN];
+static char depth_diagnostics_dropped_str[] = "Depth samples dropped";
+static uint32_t depth_diagnostics_last_failed = 0;
+static uint32_t depth_diagnostics_last_stale = 0;
+
+// The actuator board reports the round trip statistics of each command id
+static diagnostic_msgs__msg__KeyValue actuator_diagnostics_values[ACTUATOR_NUM_COMMANDS];
+static char actuator_diagnostics_name[] = "actuator";
+static char actuator_diagnostics_keys[ACTUATOR_NUM_COMMANDS][I2C_DIAG_KEY_LEN];
+static char actuator_diagnostics_value_strs[ACTUATOR_NUM_COMMANDS][I2C_DIAG_VALUE_LEN];
+static char actuator_diagnostics_errors_str[] = "Actuator command errors";
+static uint32_t actuator_diagnostics_last_errors = 0;
+static const char * const actuator_diagnostics_command_names[ACTUATOR_NUM_COMMANDS] = {
+	[ACTUATOR_CMD_GET_STATUS] = "get_status",
+	[ACTUATOR_CMD_OPEN_CLAW] = "open_claw",
+	[ACTUATOR_CMD_CLOSE_CLAW] = "close_claw",
+	[ACTUATOR_CMD_CLAW_TIMING] = "claw_timing",
+	[ACTUATOR_CMD_ARM_TORPEDO] = "arm_torpedo",
+	[ACTUATOR_CMD_DISARM_TORPEDO] = "disarm_torpedo",
+	[ACTUATOR_CMD_FIRE_TORPEDO] = "fire_torpedo",
+	[ACTUATOR_CMD_TORPEDO_TIMING] = "torpedo_timing",
+	[ACTUATOR_CMD_DROP_MARKER] = "drop_marker",
+	[ACTUATOR_CMD_CLEAR_DROPPER_STATUS] = "clear_dropper_status",
+	[ACTUATOR_CMD_DROPPER_TIMING] = "dropper_timing",
+	[ACTUATOR_CMD_KILL_SWITCH] = "kill_switch",
+	[ACTUATOR_CMD_RESET_ACTUATORS] = "reset_actuators",
+	[ACTUATOR_CMD_BATCH] = "batch",
+	[ACTUATOR_CMD_TIMING_TABLE] = "timing_table",
+	[ACTUATOR_CMD_GET_TIMING_HASH] = "get_timing_hash",
+};
+
+// Statistics from the previous publish, used to calculate utilization over the publish period
+static struct async_i2c_bus_stats i2c_diagnostics_last_stats[NUM_I2CS];
+static struct async_i2c_bus_stats i2c_diagnostics_stats;
+
+static void i2c_diagnostics_set_value(diagnostic_msgs__msg__DiagnosticStatus *status, const char *key, const char *format, ...) {
+	diagnostic_msgs__msg__KeyValue *entry = &status->values.data[status->values.size++];
+
+	snprintf(entry->key.data, entry->key.capacity, "%s", key);
+	entry->key.size = strlen(entry->key.data);
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(entry->value.data, entry->value.capacity, format, args);
+	va_end(args);
+	entry->value.size = strlen(entry->value.data);
+}
+
+static void i2c_diagnostics_fill_status(int bus_num, diagnostic_msgs__msg__DiagnosticStatus *status) {
+	i2c_inst_t *i2c = (bus_num == 0 ? i2c0 : i2c1);
+	struct async_i2c_bus_stats *last = &i2c_diagnostics_last_stats[bus_num];
+	struct async_i2c_bus_stats *stats = &i2c_diagnostics_stats;
+	struct async_i2c_recovery_stats recovery_stats;
+
+	async_i2c_get_bus_stats(i2c, stats);
+	async_i2c_get_recovery_stats(i2c, &recovery_stats);
+
+	uint64_t elapsed_us = stats->sample_time_us - last->sample_time_us;
+	uint32_t utilization = (elapsed_us > 0 ? ((stats->busy_time_us - last->busy_time_us) * 100) / elapsed_us : 0);
+
+	status->values.size = 0;
+	i2c_diagnostics_set_value(status, "utilization_pct", "%lu", utilization);
+	i2c_diagnostics_set_value(status, "transactions", "%lu", stats->transactions);
+	i2c_diagnostics_set_value(status, "failures", "%lu", stats->failures);
+	i2c_diagnostics_set_value(status, "abort_addr_noack", "%lu", stats->abort_counts[I2C_IC_TX_ABRT_SOURCE_ABRT_7B_ADDR_NOACK_LSB]);
+	i2c_diagnostics_set_value(status, "abort_data_noack", "%lu", stats->abort_counts[I2C_IC_TX_ABRT_SOURCE_ABRT_TXDATA_NOACK_LSB]);
+	i2c_diagnostics_set_value(status, "abort_arb_lost", "%lu", stats->abort_counts[I2C_IC_TX_ABRT_SOURCE_ARB_LOST_LSB]);
+	i2c_diagnostics_set_value(status, "abort_timeout", "%lu", stats->abort_counts[I2C_IC_TX_ABRT_SOURCE_ABRT_USER_ABRT_LSB]);
+	i2c_diagnostics_set_value(status, "recoveries", "%lu", recovery_stats.recoveries);
+	i2c_diagnostics_set_value(status, "untracked_transactions", "%lu", stats->untracked_transactions);
+
+	for (int i = 0; i < stats->num_addresses; i++) {
+		const struct async_i2c_address_stats *address_stats = &stats->addresses[i];
+		const uint32_t *hist = address_stats->latency_histogram;
+		char key[I2C_DIAG_KEY_LEN];
+
+		// Histogram buckets are < 64us, < 128us, ... < 4096us, >= 4096us
+		snprintf(key, sizeof(key), "addr_0x%02x", address_stats->address);
+		i2c_diagnostics_set_value(status, key, "n=%lu fail=%lu hist=%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+			address_stats->transactions, address_stats->failures,
+			hist[0], hist[1], hist[2], hist[3], hist[4], hist[5], hist[6], hist[7]);
+	}
+
+	if (utilization >= I2C_DIAG_WARN_UTILIZATION_PCT) {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__WARN;
+		status->message.data = i2c_diagnostics_high_utilization_str;
+		status->message.capacity = sizeof(i2c_diagnostics_high_utilization_str);
+	} else {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__OK;
+		status->message.data = i2c_diagnostics_ok_str;
+		status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+	}
+	status->message.size = strlen(status->message.data);
+
+	*last = *stats;
+}
+
+static void depth_diagnostics_fill_status(diagnostic_msgs__msg__DiagnosticStatus *status) {
+	uint32_t failed = depth_get_failed_sample_count();
+	bool dropped = (failed != depth_diagnostics_last_failed || depth_stale_count != depth_diagnostics_last_stale);
+
+	status->values.size = 0;
+	i2c_diagnostics_set_value(status, "last_published_sample", "%lu", depth_last_sample_count);
+	i2c_diagnostics_set_value(status, "failed_samples", "%lu", failed);
+	i2c_diagnostics_set_value(status, "stale_publishes", "%lu", depth_stale_count);
+	i2c_diagnostics_set_value(status, "last_sample_age_us", "%lu", (uint32_t) depth_last_sample_age_us);
+
+	if (dropped) {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__WARN;
+		status->message.data = depth_diagnostics_dropped_str;
+		status->message.capacity = sizeof(depth_diagnostics_dropped_str);
+	} else {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__OK;
+		status->message.data = i2c_diagnostics_ok_str;
+		status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+	}
+	status->message.size = strlen(status->message.data);
+
+	depth_diagnostics_last_failed = failed;
+	depth_diagnostics_last_stale = depth_stale_count;
+}
+
+static void actuator_diagnostics_fill_status(diagnostic_msgs__msg__DiagnosticStatus *status) {
+	uint32_t errors = 0;
+
+	status->values.size = 0;
+	for (int i = 0; i < ACTUATOR_NUM_COMMANDS; i++) {
+		struct actuator_command_stats stats;
+		actuator_get_command_stats(i, &stats);
+		errors += stats.crc_errors + stats.failed + stats.failed_results;
+
+		// Commands which have never been sent are left out to keep the message small
+		if (stats.sent == 0) {
+			continue;
+		}
+
+		uint32_t latency_mean_us = (stats.completed ? stats.latency_total_us / stats.completed : 0);
+		i2c_diagnostics_set_value(status, actuator_diagnostics_command_names[i], "n=%lu ok=%lu crc=%lu fail=%lu res=%lu us=%lu/%lu/%lu",
+									stats.sent, stats.completed, stats.crc_errors, stats.failed, stats.failed_results,
+									stats.latency_min_us, latency_mean_us, stats.latency_max_us);
+	}
+
+	if (errors != actuator_diagnostics_last_errors) {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__WARN;
+		status->message.data = actuator_diagnostics_errors_str;
+		status->message.capacity = sizeof(actuator_diagnostics_errors_str);
+	} else {
+		status->level = diagnostic_msgs__msg__DiagnosticStatus__OK;
+		status->message.data = i2c_diagnostics_ok_str;
+		status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+	}
+	status->message.size = strlen(status->message.data);
+
+	actuator_diagnostics_last_errors = errors;
+}
+
+static void i2c_diagnostics_timer_callback(rcl_timer_t * timer, __unused int64_t last_call_time) {
+	if (timer != NULL) {
+		struct timespec ts;
+		nanos_to_timespec(rmw_uros_epoch_nanos(), &ts);
+		i2c_diagnostics_msg.header.stamp.sec = ts.tv_sec;
+		i2c_diagnostics_msg.header.stamp.nanosec = ts.tv_nsec;
+
+		int index = i2c_diagnostics_next_status;
+		diagnostic_msgs__msg__DiagnosticStatus *status = &i2c_diagnostics_status[index];
+		if (index == I2C_DIAG_DEPTH_STATUS) {
+			depth_diagnostics_fill_status(status);
+		} else if (index == I2C_DIAG_ACTUATOR_STATUS) {
+			actuator_diagnostics_fill_status(status);
+		} else {
+			i2c_diagnostics_fill_status(index, status);
+		}
+		i2c_diagnostics_next_status = (index + 1) % I2C_DIAG_NUM_STATUSES;
+
+		i2c_diagnostics_msg.status.data = status;
+		RCSOFTCHECK(rcl_publish(&i2c_diagnostics_publisher, &i2c_diagnostics_msg, NULL));
+	}
+}
+
+static void i2c_diagnostics_init(rclc_support_t *support, rcl_node_t *node, rclc_executor_t *executor) {
+	RCCHECK(rclc_publisher_init(
+		&i2c_diagnostics_publisher,
+		node,
+		ROSIDL_GET_MSG_TYPE_SUPPORT(diagnostic_msgs, msg, DiagnosticArray),
+		"state/i2c_diagnostics",
+		&rmw_qos_profile_default));
+
+	RCCHECK(rclc_timer_init_default(
+		&i2c_diagnostics_timer,
+		support,
+		RCL_MS_TO_NS(i2c_diagnostics_publish_rate_ms / I2C_DIAG_NUM_STATUSES),
+		i2c_diagnostics_timer_callback));
+
+	RCCHECK(rclc_executor_add_timer(executor, &i2c_diagnostics_timer));
+
+	i2c_diagnostics_msg.header.frame_id.data = copro_frame;
+	i2c_diagnostics_msg.header.frame_id.capacity = sizeof(copro_frame);
+	i2c_diagnostics_msg.header.frame_id.size = strlen(copro_frame);
+
+	i2c_diagnostics_msg.status.data = &i2c_diagnostics_status[0];
+	i2c_diagnostics_msg.status.capacity = 1;
+	i2c_diagnostics_msg.status.size = 1;
+
+	for (int bus = 0; bus < NUM_I2CS; bus++) {
+		diagnostic_msgs__msg__DiagnosticStatus *status = &i2c_diagnostics_status[bus];
+
+		snprintf(i2c_diagnostics_names[bus], I2C_DIAG_NAME_LEN, "i2c%d", bus);
+		status->name.data = i2c_diagnostics_names[bus];
+		status->name.capacity = I2C_DIAG_NAME_LEN;
+		status->name.size = strlen(i2c_diagnostics_names[bus]);
+
+		status->hardware_id.data = i2c_diagnostics_hardware_id;
+		status->hardware_id.capacity = sizeof(i2c_diagnostics_hardware_id);
+		status->hardware_id.size = strlen(i2c_diagnostics_hardware_id);
+
+		status->message.data = i2c_diagnostics_ok_str;
+		status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+		status->message.size = strlen(i2c_diagnostics_ok_str);
+
+		status->values.data = i2c_diagnostics_values[bus];
+		status->values.capacity = I2C_DIAG_NUM_VALUES;
+		status->values.size = 0;
+
+		for (int i = 0; i < I2C_DIAG_NUM_VALUES; i++) {
+			i2c_diagnostics_values[bus][i].key.data = i2c_diagnostics_keys[bus][i];
+			i2c_diagnostics_values[bus][i].key.capacity = I2C_DIAG_KEY_LEN;
+			i2c_diagnostics_values[bus][i].key.size = 0;
+			i2c_diagnostics_values[bus][i].value.data = i2c_diagnostics_value_strs[bus][i];
+			i2c_diagnostics_values[bus][i].value.capacity = I2C_DIAG_VALUE_LEN;
+			i2c_diagnostics_values[bus][i].value.size = 0;
+		}
+	}
+
+	diagnostic_msgs__msg__DiagnosticStatus *depth_status = &i2c_diagnostics_status[I2C_DIAG_DEPTH_STATUS];
+	depth_status->name.data = depth_diagnostics_name;
+	depth_status->name.capacity = sizeof(depth_diagnostics_name);
+	depth_status->name.size = strlen(depth_diagnostics_name);
+
+	depth_status->hardware_id.data = i2c_diagnostics_hardware_id;
+	depth_status->hardware_id.capacity = sizeof(i2c_diagnostics_hardware_id);
+	depth_status->hardware_id.size = strlen(i2c_diagnostics_hardware_id);
+
+	depth_status->message.data = i2c_diagnostics_ok_str;
+	depth_status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+	depth_status->message.size = strlen(i2c_diagnostics_ok_str);
+
+	depth_status->values.data = depth_diagnostics_values;
+	depth_status->values.capacity = I2C_DIAG_NUM_DEPTH_VALUES;
+	depth_status->values.size = 0;
+
+	for (int i = 0; i < I2C_DIAG_NUM_DEPTH_VALUES; i++) {
+		depth_diagnostics_values[i].key.data = depth_diagnostics_keys[i];
+		depth_diagnostics_values[i].key.capacity = I2C_DIAG_KEY_LEN;
+		depth_diagnostics_values[i].key.size = 0;
+		depth_diagnostics_values[i].value.data = depth_diagnostics_value_strs[i];
+		depth_diagnostics_values[i].value.capacity = I2C_DIAG_VALUE_LEN;
+		depth_diagnostics_values[i].value.size = 0;
+	}
+
+	diagnostic_msgs__msg__DiagnosticStatus *actuator_status = &i2c_diagnostics_status[I2C_DIAG_ACTUATOR_STATUS];
+	actuator_status->name.data = actuator_diagnostics_name;
+	actuator_status->name.capacity = sizeof(actuator_diagnostics_name);
+	actuator_status->name.size = strlen(actuator_diagnostics_name);
+
+	actuator_status->hardware_id.data = i2c_diagnostics_hardware_id;
+	actuator_status->hardware_id.capacity = sizeof(i2c_diagnostics_hardware_id);
+	actuator_status->hardware_id.size = strlen(i2c_diagnostics_hardware_id);
+
+	actuator_status->message.data = i2c_diagnostics_ok_str;
+	actuator_status->message.capacity = sizeof(i2c_diagnostics_ok_str);
+	actuator_status->message.size = strlen(i2c_diagnostics_ok_str);
+
+	actuator_status->values.data = actuator_diagnostics_values;
+	actuator_status->values.capacity = ACTUATOR_NUM_COMMANDS;
+	actuator_status->values.size = 0;
+
+	for (int i = 0; i < ACTUATOR_NUM_COMMANDS; i++) {
+		actuator_diagnostics_values[i].key.data = actuator_diagnostics_keys[i];
+		actuator_diagnostics_values[i].key.capacity = I2C_DIAG_KEY_LEN;
+		actuator_diagnostics_values[i].key.size = 0;
+		actuator_diagnostics_values[i].value.data = actuator_diagnostics_value_strs[i];
+		actuator_diagnostics_values[i].value.capacity = I2C_DIAG_VALUE_LEN;
+		actuator_diagnostics_values[i].value.size = 0;
+	}
+}
+
+static void i2c_diagnostics_cleanup(rcl_node_t *node) {
+	RCCHECK(rcl_publisher_fini(&i2c_diagnostics_publisher, node));
+	RCCHECK(rcl_timer_fini(&i2c_diagnostics_timer));
+}
+
 // ========================================
 // Subscriber Callbacks
 // ========================================
@@ -559,7 +923,7 @@ static void subscriptions_fini(rcl_node_t *node){
 
 const rclc_parameter_options_t param_server_options = {
       .notify_changed_over_dds = true,
-      .max_params = 13 };
+      .max_params = ACTUATOR_NUM_PARAMETERS + DEPTH_NUM_PARAMETERS };
 
 static rclc_parameter_server_t param_server;
 
@@ -567,6 +931,8 @@ static void on_parameter_changed(Parameter * param)
 {
 	if (actuator_handle_parameter_change(param)) {
 		// Nothing to be done on successful parameter change
+	} else if (depth_handle_parameter_change(param)) {
+		// Nothing to be done on successful parameter change
 	} else {
 		LOG_WARN("Unexpected parameter %s with type %d changed", param->name.data, param->value.type);
 		safety_raise_fault(FAULT_ROS_SOFT_FAIL);
@@ -578,6 +944,7 @@ static void parameter_server_init(rcl_node_t *node, rclc_executor_t *executor) {
 	RCCHECK(rclc_executor_add_parameter_server(executor, &param_server, on_parameter_changed));
 
 	RCCHECK(actuator_create_parameters(&param_server));
+	RCCHECK(depth_create_parameters(&param_server));
 	// TODO: Add cooling threshold as a parameter
 }
 
@@ -616,13 +983,14 @@ void ros_start(const char* namespace) {
 	RCCHECK(rclc_node_init_default(&node, "coprocessor_node", namespace, &support));
 
 	// create executor
-	const uint num_executor_tasks = 7 + RCLC_PARAMETER_EXECUTOR_HANDLES_NUMBER;
+	const uint num_executor_tasks = 8 + RCLC_PARAMETER_EXECUTOR_HANDLES_NUMBER;
 	executor = rclc_executor_get_zero_initialized_executor();
 	RCCHECK(rclc_executor_init(&executor, &support.context, num_executor_tasks, &allocator));
 
 	parameter_server_init(&node, &executor);
 	depth_publisher_init(&support, &node, &executor);
 	state_publish_init(&support, &node, &executor);
+	i2c_diagnostics_init(&support, &node, &executor);
 	subscriptions_init(&node, &executor);
 }
 
@@ -634,6 +1002,7 @@ void ros_cleanup(void) {
 	parameter_server_fini(&node);
 	depth_publisher_cleanup(&node);
 	state_publish_cleanup(&node);
+	i2c_diagnostics_cleanup(&node);
 	subscriptions_fini(&node);
 
 	RCCHECK(rclc_executor_fini(&executor));
@@ -0,0 +1,107 @@
+#ifndef _ACTUATOR_I2C__BATCH_H
+#define _ACTUATOR_I2C__BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "actuator_i2c/commands.h"
+#include "actuator_i2c/responses.h"
+
+// Batches cannot be nested, and a reset has no response to return
+#define ACTUATOR_BATCH_CAN_CONTAIN(cmd_id) ((cmd_id) != ACTUATOR_CMD_BATCH && (cmd_id) != ACTUATOR_CMD_RESET_ACTUATORS && \
+                                            ACTUATOR_GET_CMD_SIZE(cmd_id) != 0 && ACTUATOR_GET_RESPONSE_SIZE(cmd_id) != 0)
+
+/**
+ * @brief Returns the size of a batch entry, being the command id and its data
+ * Only valid if ACTUATOR_BATCH_CAN_CONTAIN(cmd_id)
+ */
+static inline size_t actuator_i2c_batch_entry_size(enum actuator_command cmd_id) {
+    return ACTUATOR_GET_CMD_SIZE(cmd_id) - offsetof(actuator_i2c_cmd_t, cmd_id);
+}
+
+/**
+ * @brief Returns the size of the response data of a batch entry
+ * Only valid if ACTUATOR_BATCH_CAN_CONTAIN(cmd_id)
+ */
+static inline size_t actuator_i2c_batch_entry_response_size(enum actuator_command cmd_id) {
+    return ACTUATOR_GET_RESPONSE_SIZE(cmd_id) - ACTUATOR_BASE_RESPONSE_LENGTH;
+}
+
+/**
+ * @brief Starts an empty batch frame in cmd
+ */
+static inline void actuator_i2c_batch_init(actuator_i2c_cmd_t *cmd) {
+    cmd->cmd_id = ACTUATOR_CMD_BATCH;
+    cmd->data.batch.version = ACTUATOR_BATCH_VERSION;
+    cmd->data.batch.payload_length = 0;
+}
+
+/**
+ * @brief Returns the number of bytes to send for the batch frame, including the crc
+ */
+static inline size_t actuator_i2c_batch_get_cmd_size(const actuator_i2c_cmd_t *cmd) {
+    return ACTUATOR_GET_CMD_SIZE(ACTUATOR_CMD_BATCH) + cmd->data.batch.payload_length;
+}
+
+/**
+ * @brief Validates the entries of a batch and calculates the size of its response, including the crc
+ *
+ * @param batch The batch to check
+ * @param response_size Output for the response size
+ * @return true The batch is valid
+ * @return false The batch contains an entry which cannot be batched, or the entries do not fit the frame
+ */
+static inline bool actuator_i2c_batch_get_response_size(const struct batch_cmd *batch, size_t *response_size) {
+    size_t offset = 0;
+    size_t data_size = 0;
+
+    if (batch->payload_length > ACTUATOR_BATCH_MAX_PAYLOAD) {
+        return false;
+    }
+
+    while (offset < batch->payload_length) {
+        enum actuator_command cmd_id = batch->payload[offset];
+        if (!ACTUATOR_BATCH_CAN_CONTAIN(cmd_id)) {
+            return false;
+        }
+        offset += actuator_i2c_batch_entry_size(cmd_id);
+        data_size += actuator_i2c_batch_entry_response_size(cmd_id);
+    }
+
+    if (offset != batch->payload_length || data_size > ACTUATOR_BATCH_MAX_RESPONSE) {
+        return false;
+    }
+
+    *response_size = ACTUATOR_BASE_RESPONSE_LENGTH + data_size;
+    return true;
+}
+
+/**
+ * @brief Appends a command to a batch frame
+ *
+ * @param cmd The batch frame to append to
+ * @param entry The command to append. Only the command id and data are used
+ * @return true The command was added
+ * @return false The command cannot be batched or there is not enough space left in the frame or its response
+ */
+static inline bool actuator_i2c_batch_add(actuator_i2c_cmd_t *cmd, const actuator_i2c_cmd_t *entry) {
+    struct batch_cmd *batch = &cmd->data.batch;
+    size_t response_size;
+
+    if (!ACTUATOR_BATCH_CAN_CONTAIN(entry->cmd_id) || !actuator_i2c_batch_get_response_size(batch, &response_size)) {
+        return false;
+    }
+
+    size_t entry_size = actuator_i2c_batch_entry_size(entry->cmd_id);
+    if (batch->payload_length + entry_size > ACTUATOR_BATCH_MAX_PAYLOAD ||
+            response_size - ACTUATOR_BASE_RESPONSE_LENGTH + actuator_i2c_batch_entry_response_size(entry->cmd_id) > ACTUATOR_BATCH_MAX_RESPONSE) {
+        return false;
+    }
+
+    memcpy(&batch->payload[batch->payload_length], &entry->cmd_id, entry_size);
+    batch->payload_length += entry_size;
+    return true;
+}
+
+#endif
@@ -20,10 +20,16 @@ enum actuator_command {
     ACTUATOR_CMD_DROPPER_TIMING = 10,
     ACTUATOR_CMD_KILL_SWITCH = 11,
     ACTUATOR_CMD_RESET_ACTUATORS = 12,
+    ACTUATOR_CMD_BATCH = 13,
+    ACTUATOR_CMD_TIMING_TABLE = 14,
+    ACTUATOR_CMD_GET_TIMING_HASH = 15,
+
+    ACTUATOR_NUM_COMMANDS
 } __attribute__ ((packed));
 static_assert(sizeof(enum actuator_command) == 1, "Actuator command enum did not pack properly");
 
 #define ACTUATOR_CMD_GET_STATUS_LENGTH 0
+#define ACTUATOR_CMD_GET_TIMING_HASH_LENGTH 0
 #define ACTUATOR_CMD_OPEN_CLAW_LENGTH 0
 #define ACTUATOR_CMD_CLOSE_CLAW_LENGTH 0
 #define ACTUATOR_CMD_ARM_TORPEDO_LENGTH 0
@@ -82,6 +88,30 @@ struct kill_switch_cmd {
 } __attribute__ ((packed));
 #define ACTUATOR_CMD_KILL_SWITCH_LENGTH sizeof(struct kill_switch_cmd)
 
+// Sets every timing in one command. A timing of 0 leaves that timing unchanged
+struct timing_table_cmd {
+    uint16_t claw_open_time_ms;
+    uint16_t claw_close_time_ms;
+    uint16_t dropper_active_time_ms;
+    uint16_t torpedo1_timings_us[ACTUATOR_NUM_TORPEDO_TIMINGS];
+    uint16_t torpedo2_timings_us[ACTUATOR_NUM_TORPEDO_TIMINGS];
+} __attribute__ ((packed));
+#define ACTUATOR_CMD_TIMING_TABLE_LENGTH sizeof(struct timing_table_cmd)
+
+// Batch frames carry several commands in one transaction, with a single crc for the whole frame
+// The payload is a sequence of entries, each being a command id followed by that command's data
+// The response contains the response data of each entry in order, without the individual crcs
+#define ACTUATOR_BATCH_VERSION 1
+#define ACTUATOR_BATCH_MAX_PAYLOAD 16
+
+struct batch_cmd {
+    uint8_t version;
+    uint8_t payload_length;
+    uint8_t payload[ACTUATOR_BATCH_MAX_PAYLOAD];
+} __attribute__ ((packed));
+// Only the batch header, the full length is this plus payload_length
+#define ACTUATOR_CMD_BATCH_LENGTH offsetof(struct batch_cmd, payload)
+
 typedef struct actuator_i2c_cmd {
     uint8_t crc8;
     enum actuator_command cmd_id;
@@ -92,6 +122,8 @@ typedef struct actuator_i2c_cmd {
         struct torpedo_timing_cmd torpedo_timing;
         struct dropper_timing_cmd dropper_timing;
         struct kill_switch_cmd kill_switch;
+        struct batch_cmd batch;
+        struct timing_table_cmd timing_table;
     } data;
 } __attribute__ ((packed)) actuator_i2c_cmd_t;
 
@@ -111,6 +143,9 @@ typedef struct actuator_i2c_cmd {
     cmd_id == ACTUATOR_CMD_DROPPER_TIMING ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_DROPPER_TIMING_LENGTH : \
     cmd_id == ACTUATOR_CMD_KILL_SWITCH ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_KILL_SWITCH_LENGTH : \
     cmd_id == ACTUATOR_CMD_RESET_ACTUATORS ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_RESET_ACTUATORS_LENGTH : \
+    cmd_id == ACTUATOR_CMD_BATCH ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_BATCH_LENGTH : \
+    cmd_id == ACTUATOR_CMD_TIMING_TABLE ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_TIMING_TABLE_LENGTH : \
+    cmd_id == ACTUATOR_CMD_GET_TIMING_HASH ? ACTUATOR_BASE_CMD_LENGTH + ACTUATOR_CMD_GET_TIMING_HASH_LENGTH : \
     0 \
 )
 
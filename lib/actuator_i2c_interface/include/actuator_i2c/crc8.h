@@ -22,4 +22,19 @@ static inline uint8_t actuator_i2c_crc8_calc_response(const actuator_i2c_respons
     return actuator_i2c_crc8_calc_raw(((uint8_t*)status)+1, len-1);
 }
 
+/**
+ * @brief Calculates a Fletcher-16 hash of a timing table
+ * Returned by ACTUATOR_CMD_GET_TIMING_HASH so that the copro only resends the timing table when it differs
+ */
+static inline uint16_t actuator_i2c_timing_table_hash(const struct timing_table_cmd *table) {
+    const uint8_t *data = (const uint8_t*) table;
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = 0; i < sizeof(*table); i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
 #endif
\ No newline at end of file
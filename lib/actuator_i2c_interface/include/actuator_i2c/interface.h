@@ -1,12 +1,18 @@
 #ifndef _ACTUATOR_I2C__INTERFACE_H
 #define _ACTUATOR_I2C__INTERFACE_H
 
+#include "actuator_i2c/batch.h"
 #include "actuator_i2c/commands.h"
 #include "actuator_i2c/crc8.h"
 #include "actuator_i2c/responses.h"
 
 #define ACTUATOR_I2C_ADDR 0x3A
 #define ACTUATOR_EXPECTED_FIRMWARE_MAJOR ((int)1)
-#define ACTUATOR_EXPECTED_FIRMWARE_MINOR ((int)0)
+#define ACTUATOR_EXPECTED_FIRMWARE_MINOR ((int)2)
+
+// The first firmware minor version which supports ACTUATOR_CMD_BATCH
+#define ACTUATOR_BATCH_MIN_FIRMWARE_MINOR ((int)1)
+// The first firmware minor version which supports ACTUATOR_CMD_TIMING_TABLE and ACTUATOR_CMD_GET_TIMING_HASH
+#define ACTUATOR_TIMING_TABLE_MIN_FIRMWARE_MINOR ((int)2)
 
 #endif
\ No newline at end of file
@@ -64,7 +64,7 @@ struct firmware_status {
     uint8_t version_minor:4;
     uint8_t fault_list;
     struct missing_timings_status missing_timings;
-} __attribute__ ((packed)) status;
+} __attribute__ ((packed));
 static_assert(sizeof(struct firmware_status) == 4, "Firmware status struct did not pack properly");
 
 
@@ -78,6 +78,12 @@ struct actuator_i2c_status {
 } __attribute__ ((packed));
 #define ACTUATOR_STATUS_LENGTH sizeof(struct actuator_i2c_status)
 
+// Kept out of the status so that the status length is the same for every firmware version
+struct actuator_i2c_timing_hash {
+    uint16_t timing_hash;   // actuator_i2c_timing_table_hash of the timings set on the actuator board
+} __attribute__ ((packed));
+#define ACTUATOR_TIMING_HASH_LENGTH sizeof(struct actuator_i2c_timing_hash)
+
 enum actuator_command_result {
     ACTUATOR_RESULT_SUCCESSFUL = 0,
     ACTUATOR_RESULT_FAILED = 1,
@@ -86,17 +92,22 @@ enum actuator_command_result {
 static_assert(sizeof(enum claw_state) == 1, "Result enum did not pack properly");
 #define ACTUATOR_RESULT_LENGTH sizeof(enum claw_state)
 
+#define ACTUATOR_BATCH_MAX_RESPONSE 16
+
 typedef struct actuator_i2c_response {
     uint8_t crc8;
     union {
         struct actuator_i2c_status status;
         enum actuator_command_result result;
+        struct actuator_i2c_timing_hash timing_hash;
+        uint8_t batch[ACTUATOR_BATCH_MAX_RESPONSE];
     } data;
 }  __attribute__ ((packed)) actuator_i2c_response_t;
 #define ACTUATOR_BASE_RESPONSE_LENGTH offsetof(actuator_i2c_response_t, data)
 
 #define ACTUATOR_STATUS_RESP_LENGTH (ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_STATUS_LENGTH)
 #define ACTUATOR_RESULT_RESP_LENGTH (ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_RESULT_LENGTH)
+#define ACTUATOR_TIMING_HASH_RESP_LENGTH (ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_TIMING_HASH_LENGTH)
 
 #define ACTUATOR_GET_RESPONSE_SIZE(cmd_id) ( \
     cmd_id == ACTUATOR_CMD_GET_STATUS ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_STATUS_LENGTH : \
@@ -111,7 +122,10 @@ typedef struct actuator_i2c_response {
     cmd_id == ACTUATOR_CMD_CLEAR_DROPPER_STATUS ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_RESULT_LENGTH : \
     cmd_id == ACTUATOR_CMD_DROPPER_TIMING ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_RESULT_LENGTH : \
     cmd_id == ACTUATOR_CMD_KILL_SWITCH ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_RESULT_LENGTH : \
+    cmd_id == ACTUATOR_CMD_TIMING_TABLE ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_RESULT_LENGTH : \
+    cmd_id == ACTUATOR_CMD_GET_TIMING_HASH ? ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_TIMING_HASH_LENGTH : \
     cmd_id == ACTUATOR_CMD_RESET_ACTUATORS ? 0 : \
+    cmd_id == ACTUATOR_CMD_BATCH ? 0 : /* Depends on the entries, see actuator_i2c_batch_get_response_size */ \
     0 \
 )
 
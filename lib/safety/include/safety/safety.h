@@ -117,6 +117,16 @@ extern volatile uint32_t * const depth_cal_reg;
  */
 #define DEPTH_CALIBRATION_INVALID 0xFFFFFFFF
 
+/**
+ * @brief Pointer to depth sensor fluid density and gravity which will persist watchdog resets.
+ */
+extern volatile uint32_t * const depth_fluid_reg;
+
+/**
+ * @brief Value contained in depth_fluid_reg if the register contains invalid data
+ */
+#define DEPTH_FLUID_INVALID 0xFFFFFFFF
+
 /**
  * @brief Notify safety that a software reset is ocurring.
  * This sets the required watchdog scratch registers to notify of a clean boot via a watchdog reset.
@@ -172,6 +182,17 @@ void safety_init(void);
  */
 void safety_tick(void);
 
+/**
+ * @brief Lengthens the watchdog timeout to cover a known long blocking operation, such as a flash sector erase
+ * The normal timeout is restored on the next safety_tick
+ *
+ * NOT INTERRUPT SAFE
+ * REQUIRES SETUP
+ *
+ * @param timeout_ms The watchdog timeout in milliseconds to use until the next safety_tick
+ */
+void safety_extend_watchdog(uint32_t timeout_ms);
+
 
 
 
@@ -212,6 +212,9 @@ absolute_time_t safety_kill_get_last_change(void) {
 //     scratch[1]: Faulting File String Address
 //     scratch[2]: Faulting File Line
 //  - IN_ROS_TRANSPORT_LOOP: Set while blocking for response from ROS agent
+// scratch[3]: Depth Sensor Fluid Parameters
+//     Default: Should be set to 0xFFFFFFFF on clean boot
+//     Will be set when the fluid density or gravity parameters are set
 // scratch[5]: Uptime since safety init (hundreds of milliseconds)
 //             Note that with 10ms per pulse, this will overflow if running for ~1.3 years
 // scratch[6]: Bitwise Fault List
@@ -328,6 +331,7 @@ static volatile uint32_t *reset_reason_reg = &watchdog_hw->scratch[0];
 static volatile uint32_t *uptime_reg = &watchdog_hw->scratch[5];
 volatile uint32_t * const fault_list_reg = &watchdog_hw->scratch[6];
 volatile uint32_t * const depth_cal_reg = &watchdog_hw->scratch[7];
+volatile uint32_t * const depth_fluid_reg = &watchdog_hw->scratch[3];
 
 // Defined in hard_fault_handler.S
 extern void safety_hard_fault_handler(void);
@@ -528,6 +532,7 @@ static void safety_process_last_reset_cause(void) {
     } else {
         // Clear watchdog registers that maintain state through crashes
         *depth_cal_reg = DEPTH_CALIBRATION_INVALID;
+        *depth_fluid_reg = DEPTH_FLUID_INVALID;
         crash_data.crash_counter.i = 0; // Clear all crash counters to clear sticky fault
 
         // Decode the clean boot reset cause and write to log
@@ -623,6 +628,11 @@ void safety_notify_software_reset(void) {
 bool safety_initialized = false;
 bool safety_is_setup = false;
 
+/**
+ * @brief If the watchdog timeout was lengthened by safety_extend_watchdog and must be restored on the next tick
+ */
+static bool watchdog_extended = false;
+
 void safety_setup(void) {
     hard_assert_if(LIFETIME_CHECK, safety_is_setup || safety_initialized);
 
@@ -672,5 +682,17 @@ void safety_tick(void) {
         safety_refresh_kill_switches();
     }
 
-    watchdog_update();
+    if (watchdog_extended) {
+        watchdog_extended = false;
+        watchdog_enable((safety_initialized ? SAFETY_WATCHDOG_ACTIVE_TIMER_MS : SAFETY_WATCHDOG_SETUP_TIMER_MS), PAUSE_WATCHDOG_ON_DEBUG);
+    } else {
+        watchdog_update();
+    }
+}
+
+void safety_extend_watchdog(uint32_t timeout_ms) {
+    hard_assert_if(LIFETIME_CHECK, !safety_is_setup);
+
+    watchdog_extended = true;
+    watchdog_enable(timeout_ms, PAUSE_WATCHDOG_ON_DEBUG);
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "actuator_i2c/interface.h"
+#include "test_common.h"
+
+/**
+ * @brief Bitwise crc8 with the parameters of crc8_calc.c, to check the table against
+ */
+static uint8_t reference_crc8(const uint8_t *data, size_t size) {
+    uint8_t crc = 0xDE;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc ^ 0x4A;
+}
+
+/**
+ * @brief Fletcher-16 summed in 32 bits, only reducing at the end
+ */
+static uint16_t reference_fletcher16(const uint8_t *data, size_t size) {
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum1 += data[i];
+        sum2 += sum1;
+    }
+    return ((sum2 % 255) << 8) | (sum1 % 255);
+}
+
+static void test_crc8_matches_reference(void) {
+    uint8_t data[64];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) (i * 37 + 11);
+    }
+
+    for (int byte = 0; byte < 256; byte++) {
+        uint8_t single = byte;
+        TEST_CHECK_EQUAL(reference_crc8(&single, 1), actuator_i2c_crc8_calc_raw(&single, 1));
+    }
+    for (size_t size = 0; size <= sizeof(data); size++) {
+        TEST_CHECK_EQUAL(reference_crc8(data, size), actuator_i2c_crc8_calc_raw(data, size));
+    }
+}
+
+static void test_crc8_skips_crc_byte(void) {
+    actuator_i2c_cmd_t cmd = {.crc8 = 0x55, .cmd_id = ACTUATOR_CMD_KILL_SWITCH};
+    cmd.data.kill_switch.asserting_kill = true;
+    size_t size = ACTUATOR_GET_CMD_SIZE(ACTUATOR_CMD_KILL_SWITCH);
+
+    uint8_t crc = actuator_i2c_crc8_calc_command(&cmd, size);
+    cmd.crc8 = 0xAA;
+    TEST_CHECK_EQUAL(crc, actuator_i2c_crc8_calc_command(&cmd, size));
+    TEST_CHECK_EQUAL(reference_crc8(((uint8_t *) &cmd) + 1, size - 1), crc);
+
+    // A single bit flip in the data must be caught
+    cmd.data.kill_switch.asserting_kill = false;
+    TEST_CHECK(crc != actuator_i2c_crc8_calc_command(&cmd, size));
+}
+
+static void test_batch_status_poll(void) {
+    actuator_i2c_cmd_t cmd;
+    actuator_i2c_batch_init(&cmd);
+    TEST_CHECK_EQUAL(ACTUATOR_CMD_BATCH, cmd.cmd_id);
+    TEST_CHECK_EQUAL(ACTUATOR_BATCH_VERSION, cmd.data.batch.version);
+    TEST_CHECK_EQUAL(0, cmd.data.batch.payload_length);
+
+    actuator_i2c_cmd_t kill_switch = {.cmd_id = ACTUATOR_CMD_KILL_SWITCH};
+    kill_switch.data.kill_switch.asserting_kill = true;
+
+    // The copro status poll batch
+    TEST_CHECK(actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_STATUS}));
+    TEST_CHECK(actuator_i2c_batch_add(&cmd, &kill_switch));
+    TEST_CHECK(actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_TIMING_HASH}));
+
+    const uint8_t expected_payload[] = {ACTUATOR_CMD_GET_STATUS, ACTUATOR_CMD_KILL_SWITCH, 1, ACTUATOR_CMD_GET_TIMING_HASH};
+    TEST_CHECK_EQUAL(sizeof(expected_payload), cmd.data.batch.payload_length);
+    TEST_CHECK(memcmp(cmd.data.batch.payload, expected_payload, sizeof(expected_payload)) == 0);
+
+    // crc, batch id, version, length, then the payload
+    TEST_CHECK_EQUAL(4 + sizeof(expected_payload), actuator_i2c_batch_get_cmd_size(&cmd));
+
+    size_t response_size = 0;
+    TEST_CHECK(actuator_i2c_batch_get_response_size(&cmd.data.batch, &response_size));
+    TEST_CHECK_EQUAL(ACTUATOR_BASE_RESPONSE_LENGTH + ACTUATOR_STATUS_LENGTH + ACTUATOR_RESULT_LENGTH + ACTUATOR_TIMING_HASH_LENGTH,
+                     response_size);
+}
+
+static void test_batch_rejects_unbatchable(void) {
+    actuator_i2c_cmd_t cmd;
+    actuator_i2c_batch_init(&cmd);
+
+    actuator_i2c_cmd_t nested;
+    actuator_i2c_batch_init(&nested);
+    TEST_CHECK(!actuator_i2c_batch_add(&cmd, &nested));
+    TEST_CHECK(!actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_RESET_ACTUATORS}));
+    TEST_CHECK(!actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_NUM_COMMANDS}));
+    TEST_CHECK_EQUAL(0, cmd.data.batch.payload_length);
+}
+
+static void test_batch_limits(void) {
+    actuator_i2c_cmd_t cmd;
+    actuator_i2c_batch_init(&cmd);
+
+    // Each status response is 9 bytes, so only one fits in the batch response
+    TEST_CHECK(actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_STATUS}));
+    TEST_CHECK(!actuator_i2c_batch_add(&cmd, &(actuator_i2c_cmd_t){.cmd_id = ACTUATOR_CMD_GET_STATUS}));
+
+    // Claw timings are 5 bytes each, so the 16 byte payload fills on the fourth
+    actuator_i2c_batch_init(&cmd);
+    actuator_i2c_cmd_t claw_timing = {.cmd_id = ACTUATOR_CMD_CLAW_TIMING};
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK(actuator_i2c_batch_add(&cmd, &claw_timing));
+    }
+    TEST_CHECK(!actuator_i2c_batch_add(&cmd, &claw_timing));
+    TEST_CHECK_EQUAL(15, cmd.data.batch.payload_length);
+}
+
+static void test_batch_response_size_validation(void) {
+    struct batch_cmd batch = {.version = ACTUATOR_BATCH_VERSION};
+    size_t response_size;
+
+    // An entry cut off by the end of the payload
+    batch.payload[0] = ACTUATOR_CMD_CLAW_TIMING;
+    batch.payload[1] = 0;
+    batch.payload_length = 2;
+    TEST_CHECK(!actuator_i2c_batch_get_response_size(&batch, &response_size));
+
+    // An unknown command id
+    batch.payload[0] = 0xFF;
+    batch.payload_length = 1;
+    TEST_CHECK(!actuator_i2c_batch_get_response_size(&batch, &response_size));
+
+    // A payload longer than the frame
+    batch.payload[0] = ACTUATOR_CMD_OPEN_CLAW;
+    batch.payload_length = ACTUATOR_BATCH_MAX_PAYLOAD + 1;
+    TEST_CHECK(!actuator_i2c_batch_get_response_size(&batch, &response_size));
+
+    // An empty batch only has the crc in its response
+    batch.payload_length = 0;
+    TEST_CHECK(actuator_i2c_batch_get_response_size(&batch, &response_size));
+    TEST_CHECK_EQUAL(ACTUATOR_BASE_RESPONSE_LENGTH, response_size);
+}
+
+static void test_timing_table_hash(void) {
+    struct timing_table_cmd table;
+    memset(&table, 0, sizeof(table));
+    TEST_CHECK_EQUAL(0, actuator_i2c_timing_table_hash(&table));
+
+    table.claw_open_time_ms = 1500;
+    table.claw_close_time_ms = 1200;
+    table.dropper_active_time_ms = 250;
+    for (int i = 0; i < ACTUATOR_NUM_TORPEDO_TIMINGS; i++) {
+        table.torpedo1_timings_us[i] = 20000 + i * 1000;
+        table.torpedo2_timings_us[i] = 21000 + i * 1000;
+    }
+    uint16_t hash = actuator_i2c_timing_table_hash(&table);
+    TEST_CHECK_EQUAL(reference_fletcher16((const uint8_t *) &table, sizeof(table)), hash);
+
+    // Swapping two timings keeps the byte sum the same, which the position weighted sum must still catch
+    uint16_t open_time = table.claw_open_time_ms;
+    table.claw_open_time_ms = table.claw_close_time_ms;
+    table.claw_close_time_ms = open_time;
+    TEST_CHECK(hash != actuator_i2c_timing_table_hash(&table));
+}
+
+int main(void) {
+    TEST_RUN(test_crc8_matches_reference);
+    TEST_RUN(test_crc8_skips_crc_byte);
+    TEST_RUN(test_batch_status_poll);
+    TEST_RUN(test_batch_rejects_unbatchable);
+    TEST_RUN(test_batch_limits);
+    TEST_RUN(test_batch_response_size_validation);
+    TEST_RUN(test_timing_table_hash);
+    return TEST_RESULT();
+}
@@ -0,0 +1,348 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hw/depth_sensor_math.h"
+#include "models/ms5837_model.h"
+#include "test_common.h"
+
+// Runs the depth estimator over pressure traces, checking the filtered depth and velocity and the variances it reports
+// The built in traces are generated through the MS5837 model. Recorded traces can be replayed by passing them as arguments,
+// as CSV lines of "time_us,pressure_mbar" with the surface pressure as the first line
+
+#define TRACE_MAX_SAMPLES 20000
+#define TRACE_PERIOD_US (DEPTH_POLLING_RATE_MS * 1000)
+
+// Fresh water and standard gravity, the firmware defaults
+#define TRACE_FLUID_DENSITY 9970
+#define TRACE_GRAVITY 980665
+#define TRACE_SURFACE_PRESSURE_MBAR 1013
+
+// Samples at the start of a trace which are left for the estimator to settle before it is checked
+#define TRACE_SETTLE_SAMPLES 80
+
+/**
+ * @brief A pressure trace, as read from the sensor, along with the true depth for generated traces
+ */
+struct trace {
+    int count;
+    int32_t surface_pressure_mbar;
+    uint64_t time_us[TRACE_MAX_SAMPLES];
+    int32_t pressure_mbar[TRACE_MAX_SAMPLES];
+    // Only known for generated traces
+    double true_depth_mm[TRACE_MAX_SAMPLES];
+    double true_velocity_mm_s[TRACE_MAX_SAMPLES];
+};
+
+/**
+ * @brief Statistics of the estimate over a trace, after the estimator has settled
+ */
+struct trace_result {
+    int count;
+    double depth_error_mean_mm;
+    double depth_error_variance_mm2;
+    double velocity_error_mean_mm_s;
+    double velocity_error_variance_mm2_s2;
+    double reported_depth_variance_mm2;
+    double reported_velocity_variance_mm2_s2;
+    struct depth_estimate last;
+};
+
+static double trace_mm_per_mbar(void) {
+    return 1e11 / (((double) TRACE_FLUID_DENSITY) * TRACE_GRAVITY);
+}
+
+/**
+ * @brief Adds a sample to a generated trace, passing the true depth through the sensor model and the firmware pressure calculation
+ */
+static void trace_add_sample(struct trace *trace, struct ms5837_model *model, uint64_t time_us,
+                             double depth_mm, double velocity_mm_s) {
+    // The firmware truncates to whole mbar, so the model is offset by half a mbar to centre the quantization on the true value
+    model->pressure_mbar = trace->surface_pressure_mbar + depth_mm / trace_mm_per_mbar() + 0.5;
+
+    struct depth_compensation compensation;
+    depth_calculate_compensation(model->prom, ms5837_model_convert_d2(model), &compensation);
+
+    int i = trace->count++;
+    trace->time_us[i] = time_us;
+    trace->pressure_mbar[i] = depth_calculate_pressure_mbar(&compensation, ms5837_model_convert_d1(model));
+    trace->true_depth_mm[i] = depth_mm;
+    trace->true_velocity_mm_s[i] = velocity_mm_s;
+}
+
+static void trace_init(struct trace *trace, struct ms5837_model *model, uint32_t seed, double noise_mbar) {
+    trace->count = 0;
+    trace->surface_pressure_mbar = TRACE_SURFACE_PRESSURE_MBAR;
+    ms5837_model_init(model, seed);
+    model->pressure_noise_mbar = noise_mbar;
+}
+
+/**
+ * @brief Runs the estimator over the trace the same way depth_sensor.c does, collecting statistics after start_sample
+ */
+static void trace_run(const struct trace *trace, int start_sample, struct trace_result *result) {
+    struct depth_conversion conversion;
+    depth_calculate_conversion(TRACE_FLUID_DENSITY, TRACE_GRAVITY, &conversion);
+    struct depth_estimator estimator = {.running = false};
+
+    double depth_sum = 0, depth_sum_sq = 0, velocity_sum = 0, velocity_sum_sq = 0;
+    double reported_depth_sum = 0, reported_velocity_sum = 0;
+    int count = 0;
+
+    for (int i = 0; i < trace->count; i++) {
+        int32_t depth_mm = depth_pressure_to_mm(&conversion, trace->pressure_mbar[i] - trace->surface_pressure_mbar);
+        depth_estimator_step(&estimator, depth_mm, trace->time_us[i]);
+        depth_estimator_get(&estimator, &result->last);
+
+        if (i < start_sample) {
+            continue;
+        }
+        double depth_error = result->last.depth_mm - trace->true_depth_mm[i];
+        double velocity_error = result->last.velocity_mm_s - trace->true_velocity_mm_s[i];
+        depth_sum += depth_error;
+        depth_sum_sq += depth_error * depth_error;
+        velocity_sum += velocity_error;
+        velocity_sum_sq += velocity_error * velocity_error;
+        reported_depth_sum += result->last.depth_variance_mm2;
+        reported_velocity_sum += result->last.velocity_variance_mm2_s2;
+        count++;
+    }
+
+    result->count = count;
+    if (count == 0) {
+        return;
+    }
+    result->depth_error_mean_mm = depth_sum / count;
+    result->depth_error_variance_mm2 = depth_sum_sq / count - result->depth_error_mean_mm * result->depth_error_mean_mm;
+    result->velocity_error_mean_mm_s = velocity_sum / count;
+    result->velocity_error_variance_mm2_s2 = velocity_sum_sq / count - result->velocity_error_mean_mm_s * result->velocity_error_mean_mm_s;
+    result->reported_depth_variance_mm2 = reported_depth_sum / count;
+    result->reported_velocity_variance_mm2_s2 = reported_velocity_sum / count;
+}
+
+static void trace_print(const char *name, const struct trace_result *result) {
+    printf("%s: depth error %.1f mm (var %.1f, reported %.1f), velocity error %.1f mm/s (var %.0f, reported %.0f)\n",
+           name, result->depth_error_mean_mm, result->depth_error_variance_mm2, result->reported_depth_variance_mm2,
+           result->velocity_error_mean_mm_s, result->velocity_error_variance_mm2_s2, result->reported_velocity_variance_mm2_s2);
+}
+
+/**
+ * @brief Checks that the reported variance is within a factor of two of the variance of the error against the true value
+ */
+#define CHECK_VARIANCE_MATCHES(measured, reported) do { \
+        TEST_CHECK((reported) <= 2 * (measured)); \
+        TEST_CHECK((measured) <= 2 * (reported)); \
+    } while (0)
+
+/**
+ * @brief Checks that the reported variance is an upper bound of the error variance, by no more than a factor of four
+ * The variance gains assume the acceleration noise the filter was designed for. Without it, the velocity estimate is quieter
+ * than reported, as its variance comes from a residual with no manoeuvring in it
+ */
+#define CHECK_VARIANCE_BOUNDS(measured, reported) do { \
+        TEST_CHECK((measured) <= (reported)); \
+        TEST_CHECK((reported) <= 4 * (measured)); \
+    } while (0)
+
+static struct trace trace;
+
+/**
+ * @brief Holding a constant depth, the estimate should be unbiased and quieter than the readings
+ */
+static void test_hold_depth(void) {
+    struct ms5837_model model;
+    trace_init(&trace, &model, 1, 1.0);
+    for (int i = 0; i < 4000; i++) {
+        trace_add_sample(&trace, &model, 1000000 + i * TRACE_PERIOD_US, 2000, 0);
+    }
+
+    struct trace_result result;
+    trace_run(&trace, TRACE_SETTLE_SAMPLES, &result);
+    trace_print("hold", &result);
+
+    TEST_CHECK(fabs(result.depth_error_mean_mm) < 2);
+    TEST_CHECK(fabs(result.velocity_error_mean_mm_s) < 5);
+    // The readings have a standard deviation of about 10 mm
+    TEST_CHECK(result.depth_error_variance_mm2 < 0.5 * 100);
+    CHECK_VARIANCE_MATCHES(result.depth_error_variance_mm2, result.reported_depth_variance_mm2);
+    CHECK_VARIANCE_BOUNDS(result.velocity_error_variance_mm2_s2, result.reported_velocity_variance_mm2_s2);
+}
+
+/**
+ * @brief A constant rate descent, which an alpha-beta filter should track without lag
+ */
+static void test_descent(void) {
+    const double velocity_mm_s = 300;
+    struct ms5837_model model;
+    trace_init(&trace, &model, 2, 1.0);
+    for (int i = 0; i < 4000; i++) {
+        double time_s = i * TRACE_PERIOD_US / 1e6;
+        trace_add_sample(&trace, &model, 1000000 + i * TRACE_PERIOD_US, 500 + velocity_mm_s * time_s, velocity_mm_s);
+    }
+
+    struct trace_result result;
+    trace_run(&trace, TRACE_SETTLE_SAMPLES, &result);
+    trace_print("descent", &result);
+
+    TEST_CHECK(fabs(result.depth_error_mean_mm) < 2);
+    TEST_CHECK(fabs(result.velocity_error_mean_mm_s) < 5);
+    CHECK_VARIANCE_MATCHES(result.depth_error_variance_mm2, result.reported_depth_variance_mm2);
+    CHECK_VARIANCE_BOUNDS(result.velocity_error_variance_mm2_s2, result.reported_velocity_variance_mm2_s2);
+}
+
+/**
+ * @brief Manoeuvring with the white acceleration noise the filter gains were chosen for, where both variances should match
+ * For the Kalata beta, the acceleration noise over a sample period is beta^2 / (1 - alpha) times the reading variance
+ */
+static void test_manoeuvring(void) {
+    const double reading_variance_mm2 = 1.0 / 12 * trace_mm_per_mbar() * trace_mm_per_mbar() +
+                                        trace_mm_per_mbar() * trace_mm_per_mbar();
+    const double alpha = 0.4;
+    const double beta = 2 * (2 - alpha) - 4 * sqrt(1 - alpha);
+    const double period_s = TRACE_PERIOD_US / 1e6;
+    // Standard deviation of the acceleration held over each sample period in mm/s^2
+    const double accel_std = sqrt(beta * beta / (1 - alpha) * reading_variance_mm2) / (period_s * period_s);
+
+    // Several short runs starting well below the surface, so the random walk in velocity stays in the sensor range
+    struct trace_result total = {0};
+    const int num_runs = 16;
+    for (int run = 0; run < num_runs; run++) {
+        struct ms5837_model model;
+        trace_init(&trace, &model, 100 + run, 1.0);
+        uint32_t rng_state = 1000 + run;
+        double depth_mm = 50000;
+        double velocity_mm_s = 0;
+        for (int i = 0; i < 600; i++) {
+            trace_add_sample(&trace, &model, 1000000 + i * TRACE_PERIOD_US, depth_mm, velocity_mm_s);
+            double accel = accel_std * ms5837_model_gaussian(&rng_state);
+            depth_mm += velocity_mm_s * period_s + accel * period_s * period_s / 2;
+            velocity_mm_s += accel * period_s;
+        }
+
+        struct trace_result result;
+        trace_run(&trace, TRACE_SETTLE_SAMPLES, &result);
+        total.depth_error_mean_mm += result.depth_error_mean_mm / num_runs;
+        total.depth_error_variance_mm2 += result.depth_error_variance_mm2 / num_runs;
+        total.velocity_error_mean_mm_s += result.velocity_error_mean_mm_s / num_runs;
+        total.velocity_error_variance_mm2_s2 += result.velocity_error_variance_mm2_s2 / num_runs;
+        total.reported_depth_variance_mm2 += result.reported_depth_variance_mm2 / num_runs;
+        total.reported_velocity_variance_mm2_s2 += result.reported_velocity_variance_mm2_s2 / num_runs;
+    }
+    trace_print("manoeuvring", &total);
+
+    TEST_CHECK(fabs(total.depth_error_mean_mm) < 2);
+    TEST_CHECK(fabs(total.velocity_error_mean_mm_s) < 10);
+    CHECK_VARIANCE_MATCHES(total.depth_error_variance_mm2, total.reported_depth_variance_mm2);
+    CHECK_VARIANCE_MATCHES(total.velocity_error_variance_mm2_s2, total.reported_velocity_variance_mm2_s2);
+}
+
+/**
+ * @brief A sudden change in depth should raise the reported variance, then settle back to the new depth
+ */
+static void test_step(void) {
+    struct ms5837_model model;
+    trace_init(&trace, &model, 3, 1.0);
+    for (int i = 0; i < 400; i++) {
+        trace_add_sample(&trace, &model, 1000000 + i * TRACE_PERIOD_US, (i < 200 ? 1000 : 2000), 0);
+    }
+
+    struct trace_result settled, stepped;
+    trace_run(&trace, 0, &settled);
+    trace.count = 205;
+    trace_run(&trace, 0, &stepped);
+
+    // Shortly after the step, the estimate is on its way to the new depth and reports the surprise in its variance
+    TEST_CHECK(stepped.last.depth_variance_mm2 > 10 * settled.last.depth_variance_mm2);
+    TEST_CHECK(stepped.last.depth_mm > 1500 && stepped.last.depth_mm < 2200);
+
+    // Settled after 5 seconds
+    TEST_CHECK(abs(settled.last.depth_mm - 2000) < 20);
+    TEST_CHECK(abs(settled.last.velocity_mm_s) < 40);
+}
+
+/**
+ * @brief Skipped polls are predicted over, and a long gap restarts the estimator at the next reading
+ */
+static void test_gaps(void) {
+    const double velocity_mm_s = 200;
+    struct ms5837_model model;
+    trace_init(&trace, &model, 4, 0);
+    uint64_t time_us = 1000000;
+    for (int i = 0; i < 400; i++) {
+        // Every third poll is skipped
+        time_us += (i % 3 == 0 ? 2 : 1) * TRACE_PERIOD_US;
+        trace_add_sample(&trace, &model, time_us, velocity_mm_s * time_us / 1e6, velocity_mm_s);
+    }
+
+    struct trace_result result;
+    trace_run(&trace, TRACE_SETTLE_SAMPLES, &result);
+    trace_print("gaps", &result);
+    TEST_CHECK(fabs(result.depth_error_mean_mm) < 5);
+    TEST_CHECK(fabs(result.velocity_error_mean_mm_s) < 5);
+
+    // A gap after which the vehicle is somewhere else entirely
+    time_us += 10 * DEPTH_POLLING_RATE_MS * 1000;
+    trace_add_sample(&trace, &model, time_us, 8000, 0);
+    trace_run(&trace, trace.count, &result);
+    TEST_CHECK(abs(result.last.depth_mm - 8000) < 20);
+    TEST_CHECK_EQUAL(0, result.last.velocity_mm_s);
+}
+
+/**
+ * @brief Loads a recorded trace, returning false if the file couldn't be read
+ */
+static bool trace_load(struct trace *trace, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    unsigned long long time_us;
+    long pressure_mbar;
+    trace->count = 0;
+    bool valid = (fscanf(file, "%ld", &pressure_mbar) == 1);
+    trace->surface_pressure_mbar = pressure_mbar;
+    while (valid && trace->count < TRACE_MAX_SAMPLES && fscanf(file, "%llu,%ld", &time_us, &pressure_mbar) == 2) {
+        trace->time_us[trace->count] = time_us;
+        trace->pressure_mbar[trace->count] = pressure_mbar;
+        trace->count++;
+    }
+    fclose(file);
+    return valid && trace->count > 0;
+}
+
+/**
+ * @brief Replays a recorded trace. The true depth isn't known, so the estimate is checked to follow the readings without bias
+ */
+static void test_recorded_trace(const char *path) {
+    TEST_CHECK(trace_load(&trace, path));
+
+    struct depth_conversion conversion;
+    depth_calculate_conversion(TRACE_FLUID_DENSITY, TRACE_GRAVITY, &conversion);
+    for (int i = 0; i < trace.count; i++) {
+        trace.true_depth_mm[i] = depth_pressure_to_mm(&conversion, trace.pressure_mbar[i] - trace.surface_pressure_mbar);
+        // Not checked
+        trace.true_velocity_mm_s[i] = 0;
+    }
+
+    struct trace_result result;
+    trace_run(&trace, TRACE_SETTLE_SAMPLES, &result);
+    printf("%s: %d samples, ", path, result.count);
+    trace_print("recorded", &result);
+    TEST_CHECK(fabs(result.depth_error_mean_mm) < 20);
+    TEST_CHECK(result.reported_depth_variance_mm2 > 0);
+}
+
+int main(int argc, char **argv) {
+    TEST_RUN(test_hold_depth);
+    TEST_RUN(test_descent);
+    TEST_RUN(test_manoeuvring);
+    TEST_RUN(test_step);
+    TEST_RUN(test_gaps);
+    for (int i = 1; i < argc; i++) {
+        test_recorded_trace(argv[i]);
+        printf("%s %s\n", (test_failures ? "FAIL" : "PASS"), argv[i]);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,141 @@
+#include <stdint.h>
+
+#include "hw/depth_sensor_math.h"
+#include "models/ms5837_model.h"
+#include "test_common.h"
+
+// Exhaustive checks of the fixed point depth calculations against the floating point and 64-bit divide versions they replaced
+
+// The operating range of pressure differences in mbar, the 30 bar rating of the sensor with margin
+#define MAX_PRESSURE_DIFF_MBAR 40000
+
+// Limits of the fluid parameters accepted by depth_sensor.c
+#define MIN_FLUID_DENSITY 9000
+#define MAX_FLUID_DENSITY 11000
+#define MIN_GRAVITY 975000
+#define MAX_GRAVITY 985000
+
+#define DEFAULT_FLUID_DENSITY 9970
+#define DEFAULT_GRAVITY 980665
+
+/**
+ * @brief The exact depth in mm, truncated towards zero, with integer division of the unreduced fraction
+ */
+static int32_t reference_exact_mm(uint32_t density, uint32_t gravity, int32_t pressure_diff) {
+    uint64_t abs_diff = (pressure_diff < 0 ? -pressure_diff : pressure_diff);
+    int32_t depth_mm = (abs_diff * 100000000000ull) / (((uint64_t) density) * gravity);
+    return (pressure_diff < 0 ? -depth_mm : depth_mm);
+}
+
+/**
+ * @brief Checks every pressure difference against the double calculation used before the fixed point conversion
+ */
+static void test_default_fluid_matches_double(void) {
+    struct depth_conversion conversion;
+    depth_calculate_conversion(DEFAULT_FLUID_DENSITY, DEFAULT_GRAVITY, &conversion);
+
+    int mismatches = 0;
+    for (int32_t diff = -MAX_PRESSURE_DIFF_MBAR; diff <= MAX_PRESSURE_DIFF_MBAR; diff++) {
+        int32_t expected = (int32_t)(((diff * 100) / (997 * 9.80665)) * 1000);
+        if (depth_pressure_to_mm(&conversion, diff) != expected && mismatches++ == 0) {
+            TEST_CHECK_EQUAL(expected, depth_pressure_to_mm(&conversion, diff));
+        }
+    }
+    TEST_CHECK_EQUAL(0, mismatches);
+}
+
+/**
+ * @brief Checks every pressure difference for every accepted density, at standard gravity
+ */
+static void test_density_sweep_exact(void) {
+    int mismatches = 0;
+    for (uint32_t density = MIN_FLUID_DENSITY; density <= MAX_FLUID_DENSITY; density++) {
+        struct depth_conversion conversion;
+        depth_calculate_conversion(density, DEFAULT_GRAVITY, &conversion);
+
+        for (int32_t diff = 1; diff <= MAX_PRESSURE_DIFF_MBAR; diff++) {
+            int32_t expected = reference_exact_mm(density, DEFAULT_GRAVITY, diff);
+            if (depth_pressure_to_mm(&conversion, diff) != expected && mismatches++ == 0) {
+                printf("density %u, diff %d\n", density, diff);
+                TEST_CHECK_EQUAL(expected, depth_pressure_to_mm(&conversion, diff));
+            }
+        }
+    }
+    TEST_CHECK_EQUAL(0, mismatches);
+}
+
+/**
+ * @brief Checks every pressure difference for every accepted gravity, at the default density
+ */
+static void test_gravity_sweep_exact(void) {
+    int mismatches = 0;
+    for (uint32_t gravity = MIN_GRAVITY; gravity <= MAX_GRAVITY; gravity++) {
+        struct depth_conversion conversion;
+        depth_calculate_conversion(DEFAULT_FLUID_DENSITY, gravity, &conversion);
+
+        for (int32_t diff = 1; diff <= MAX_PRESSURE_DIFF_MBAR; diff++) {
+            int32_t expected = reference_exact_mm(DEFAULT_FLUID_DENSITY, gravity, diff);
+            if (depth_pressure_to_mm(&conversion, diff) != expected && mismatches++ == 0) {
+                printf("gravity %u, diff %d\n", gravity, diff);
+                TEST_CHECK_EQUAL(expected, depth_pressure_to_mm(&conversion, diff));
+            }
+        }
+    }
+    TEST_CHECK_EQUAL(0, mismatches);
+}
+
+/**
+ * @brief Checks the corners of the accepted parameters, including negative pressure differences
+ */
+static void test_parameter_corners_exact(void) {
+    const uint32_t densities[] = {MIN_FLUID_DENSITY, MAX_FLUID_DENSITY};
+    const uint32_t gravities[] = {MIN_GRAVITY, MAX_GRAVITY};
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            struct depth_conversion conversion;
+            depth_calculate_conversion(densities[i], gravities[j], &conversion);
+
+            int mismatches = 0;
+            for (int32_t diff = -MAX_PRESSURE_DIFF_MBAR; diff <= MAX_PRESSURE_DIFF_MBAR; diff++) {
+                if (depth_pressure_to_mm(&conversion, diff) != reference_exact_mm(densities[i], gravities[j], diff)) {
+                    mismatches++;
+                }
+            }
+            TEST_CHECK_EQUAL(0, mismatches);
+        }
+    }
+}
+
+/**
+ * @brief Checks the shifted pressure calculation against the 64-bit divides from the datasheet, across the ADC range
+ * Covers every temperature branch of the compensation, and D1 readings far outside the modelled pressures
+ */
+static void test_pressure_matches_divide(void) {
+    struct ms5837_model model;
+    ms5837_model_init(&model, 1);
+
+    int mismatches = 0;
+    for (uint32_t D2 = 0; D2 < (1 << 24); D2 += 4093) {
+        struct depth_compensation compensation;
+        depth_calculate_compensation(model.prom, D2, &compensation);
+
+        for (uint32_t D1 = 0; D1 < (1 << 24); D1 += 1021) {
+            int32_t expected = (int32_t)(((((int64_t) D1) * compensation.sens2 / 2097152 - compensation.off2) / 8192) / 10.0);
+            if (depth_calculate_pressure_mbar(&compensation, D1) != expected && mismatches++ == 0) {
+                printf("D2 %u, D1 %u\n", D2, D1);
+                TEST_CHECK_EQUAL(expected, depth_calculate_pressure_mbar(&compensation, D1));
+            }
+        }
+    }
+    TEST_CHECK_EQUAL(0, mismatches);
+}
+
+int main(void) {
+    TEST_RUN(test_default_fluid_matches_double);
+    TEST_RUN(test_density_sweep_exact);
+    TEST_RUN(test_gravity_sweep_exact);
+    TEST_RUN(test_parameter_corners_exact);
+    TEST_RUN(test_pressure_matches_divide);
+    return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "hw/depth_sensor_math.h"
+#include "models/ms5837_model.h"
+
+// Host timing of the depth calculations. Only the relative cost is meaningful, as the M0+ has no 64-bit divide
+
+#define BENCHMARK_ITERATIONS 1000000
+#define BENCHMARK_NUM_READINGS 256
+
+static uint64_t benchmark_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static void benchmark_report(const char *name, uint64_t start_ns, int64_t checksum) {
+    double ns_per_op = (benchmark_time_ns() - start_ns) / (double) BENCHMARK_ITERATIONS;
+    printf("%-24s %8.2f ns/op (checksum %lld)\n", name, ns_per_op, (long long) checksum);
+}
+
+int main(void) {
+    struct ms5837_model model;
+    ms5837_model_init(&model, 1);
+    model.pressure_noise_mbar = 2;
+
+    // Readings are generated up front so only the firmware calculations are timed
+    static uint32_t d1[BENCHMARK_NUM_READINGS];
+    static uint32_t d2[BENCHMARK_NUM_READINGS];
+    for (int i = 0; i < BENCHMARK_NUM_READINGS; i++) {
+        model.pressure_mbar = 1000 + i * 10;
+        model.temperature_c = 5 + (i % 25);
+        d2[i] = ms5837_model_convert_d2(&model);
+        d1[i] = ms5837_model_convert_d1(&model);
+    }
+
+    struct depth_compensation compensation;
+    struct depth_conversion conversion;
+    depth_calculate_conversion(9970, 980665, &conversion);
+    int64_t checksum = 0;
+
+    uint64_t start = benchmark_time_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        depth_calculate_compensation(model.prom, d2[i % BENCHMARK_NUM_READINGS], &compensation);
+        checksum += compensation.temperature;
+    }
+    benchmark_report("compensation", start, checksum);
+
+    checksum = 0;
+    start = benchmark_time_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        checksum += depth_calculate_pressure_mbar(&compensation, d1[i % BENCHMARK_NUM_READINGS]);
+    }
+    benchmark_report("pressure", start, checksum);
+
+    checksum = 0;
+    start = benchmark_time_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        checksum += depth_pressure_to_mm(&conversion, (i % 4000) - 1000);
+    }
+    benchmark_report("pressure_to_mm", start, checksum);
+
+    struct depth_estimator estimator = {.running = false};
+    struct depth_estimate estimate;
+    checksum = 0;
+    start = benchmark_time_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        depth_estimator_step(&estimator, (i % 4000) - 1000, ((uint64_t) i) * DEPTH_POLLING_RATE_MS * 1000);
+        depth_estimator_get(&estimator, &estimate);
+        checksum += estimate.depth_mm;
+    }
+    benchmark_report("estimator_step", start, checksum);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hw/depth_sensor_math.h"
+#include "models/ms5837_model.h"
+#include "test_common.h"
+
+/**
+ * @brief Example readings, with the expected values worked through the datasheet formulas with truncating division
+ */
+static void test_compensation_example(void) {
+    const uint16_t prom[8] = {0x0340, 34982, 36352, 20328, 22354, 26646, 26146, 0};
+    struct depth_compensation compensation;
+
+    depth_calculate_compensation(prom, 6815414, &compensation);
+    TEST_CHECK_EQUAL(1982, compensation.temperature);
+    TEST_CHECK_EQUAL(2381323465 - 486, compensation.off2);
+    TEST_CHECK_EQUAL(1145816756 - 202, compensation.sens2);
+    TEST_CHECK_EQUAL(3999, depth_calculate_pressure_mbar(&compensation, 4958179));
+}
+
+/**
+ * @brief Runs the model across the operating range, checking the firmware recovers the modelled pressure
+ * The firmware truncates to whole mbar, and the model rounds the conversions, so the result is within 1 mbar
+ */
+static void test_model_round_trip(void) {
+    struct ms5837_model model;
+    ms5837_model_init(&model, 1);
+
+    for (int temperature_c = -10; temperature_c <= 60; temperature_c += 5) {
+        model.temperature_c = temperature_c;
+        for (int pressure_mbar = 300; pressure_mbar <= 30000; pressure_mbar += 37) {
+            model.pressure_mbar = pressure_mbar + 0.5;
+
+            struct depth_compensation compensation;
+            depth_calculate_compensation(model.prom, ms5837_model_convert_d2(&model), &compensation);
+            int32_t pressure = depth_calculate_pressure_mbar(&compensation, ms5837_model_convert_d1(&model));
+
+            if (abs(pressure - pressure_mbar) > 1) {
+                TEST_CHECK_EQUAL(pressure_mbar, pressure);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Checks the depth conversion for fresh water and standard gravity
+ */
+static void test_default_conversion(void) {
+    struct depth_conversion conversion;
+    depth_calculate_conversion(9970, 980665, &conversion);
+
+    // 1e11 / (9970 * 980665) = 10.2276... mm per mbar
+    TEST_CHECK_EQUAL(10, conversion.mm_per_mbar_int);
+    TEST_CHECK_EQUAL(0, depth_pressure_to_mm(&conversion, 0));
+    TEST_CHECK_EQUAL(10, depth_pressure_to_mm(&conversion, 1));
+    TEST_CHECK_EQUAL(-10, depth_pressure_to_mm(&conversion, -1));
+    TEST_CHECK_EQUAL(10227, depth_pressure_to_mm(&conversion, 1000));
+}
+
+int main(void) {
+    TEST_RUN(test_compensation_example);
+    TEST_RUN(test_model_round_trip);
+    TEST_RUN(test_default_conversion);
+    return TEST_RESULT();
+}
@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "hw/depth_sensor_math.h"
+#include "models/ms5837_model.h"
+#include "test_common.h"
+
+// Runs zeroing over noisy surface pressure traces generated through the MS5837 model and the firmware pressure calculation
+
+#define ZERO_SURFACE_PRESSURE_MBAR 1013
+
+/**
+ * @brief Reads the model pressure the same way depth_sensor.c does
+ */
+static int32_t zero_read_pressure(struct ms5837_model *model) {
+    struct depth_compensation compensation;
+    depth_calculate_compensation(model->prom, ms5837_model_convert_d2(model), &compensation);
+    return depth_calculate_pressure_mbar(&compensation, ms5837_model_convert_d1(model));
+}
+
+/**
+ * @brief Adds samples until zeroing finishes
+ *
+ * @param model The model to read from
+ * @param spike_every Every this many samples has a spike added, or 0 for none
+ * @param spike_mbar The size of the spikes
+ * @param surface_pressure Output for the surface pressure
+ * @param num_samples Output for the number of samples taken
+ * @return enum depth_zero_result The result of the last sample
+ */
+static enum depth_zero_result zero_run(struct ms5837_model *model, int spike_every, int32_t spike_mbar,
+                                       int32_t *surface_pressure, int *num_samples) {
+    struct depth_zero_samples zero = {.count = 0};
+    enum depth_zero_result result = DEPTH_ZERO_NEEDS_SAMPLES;
+    *num_samples = 0;
+
+    while (result == DEPTH_ZERO_NEEDS_SAMPLES && *num_samples < DEPTH_ZERO_MAX_SAMPLES) {
+        int32_t pressure = zero_read_pressure(model);
+        (*num_samples)++;
+        if (spike_every && *num_samples % spike_every == 0) {
+            pressure += spike_mbar;
+        }
+        result = depth_zero_add_sample(&zero, pressure, surface_pressure);
+    }
+    return result;
+}
+
+static void zero_model_init(struct ms5837_model *model, uint32_t seed, double noise_mbar) {
+    ms5837_model_init(model, seed);
+    // The firmware truncates to whole mbar, so the model is offset by half a mbar to centre the quantization on the surface
+    model->pressure_mbar = ZERO_SURFACE_PRESSURE_MBAR + 0.5;
+    model->pressure_noise_mbar = noise_mbar;
+}
+
+/**
+ * @brief A quiet sensor should converge on the first chance, to the surface pressure
+ */
+static void test_quiet_converges_early(void) {
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        struct ms5837_model model;
+        zero_model_init(&model, seed, 0.3);
+
+        int32_t surface_pressure = 0;
+        int num_samples;
+        TEST_CHECK_EQUAL(DEPTH_ZERO_CONVERGED, zero_run(&model, 0, 0, &surface_pressure, &num_samples));
+        TEST_CHECK(num_samples <= DEPTH_ZERO_MIN_SAMPLES + 2);
+        TEST_CHECK(abs(surface_pressure - ZERO_SURFACE_PRESSURE_MBAR) <= 1);
+    }
+}
+
+/**
+ * @brief Typical sensor noise should converge within the sample limit and land within a mbar
+ */
+static void test_noisy_converges(void) {
+    int converged = 0;
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        struct ms5837_model model;
+        zero_model_init(&model, seed, 0.8);
+
+        int32_t surface_pressure = 0;
+        int num_samples;
+        if (zero_run(&model, 0, 0, &surface_pressure, &num_samples) == DEPTH_ZERO_CONVERGED) {
+            converged++;
+        }
+        TEST_CHECK(abs(surface_pressure - ZERO_SURFACE_PRESSURE_MBAR) <= 1);
+    }
+    TEST_CHECK(converged >= 180);
+}
+
+/**
+ * @brief Spikes, such as from a wave or the vehicle being handled, are rejected without moving the surface pressure
+ */
+static void test_rejects_spikes(void) {
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        struct ms5837_model model;
+        zero_model_init(&model, seed, 0.3);
+
+        // Both high and low, up to one in three samples
+        int32_t surface_pressure = 0;
+        int num_samples;
+        TEST_CHECK_EQUAL(DEPTH_ZERO_CONVERGED, zero_run(&model, 3, (seed % 2 ? 40 : -25), &surface_pressure, &num_samples));
+        TEST_CHECK(abs(surface_pressure - ZERO_SURFACE_PRESSURE_MBAR) <= 1);
+    }
+}
+
+/**
+ * @brief A sensor too noisy to converge should almost always stop at the sample limit, still reporting its best estimate
+ * Five samples can happen to land close together, so a few runs still converge, on a less accurate surface pressure
+ */
+static void test_too_noisy_gives_up(void) {
+    int not_converged = 0;
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        struct ms5837_model model;
+        zero_model_init(&model, seed, 4.0);
+
+        int32_t surface_pressure = 0;
+        int num_samples;
+        if (zero_run(&model, 0, 0, &surface_pressure, &num_samples) == DEPTH_ZERO_NOT_CONVERGED) {
+            not_converged++;
+            TEST_CHECK_EQUAL(DEPTH_ZERO_MAX_SAMPLES, num_samples);
+            TEST_CHECK(abs(surface_pressure - ZERO_SURFACE_PRESSURE_MBAR) <= 5);
+        } else {
+            TEST_CHECK(abs(surface_pressure - ZERO_SURFACE_PRESSURE_MBAR) <= 8);
+        }
+    }
+    TEST_CHECK(not_converged >= 180);
+}
+
+/**
+ * @brief Checks the rounding of the mean, which is taken relative to the median
+ */
+static void test_exact_samples(void) {
+    const int32_t samples[] = {1000, 1001, 1001, 1000, 1001};
+    struct depth_zero_samples zero = {.count = 0};
+    int32_t surface_pressure = 0;
+
+    for (int i = 0; i < 4; i++) {
+        TEST_CHECK_EQUAL(DEPTH_ZERO_NEEDS_SAMPLES, depth_zero_add_sample(&zero, samples[i], &surface_pressure));
+    }
+    TEST_CHECK_EQUAL(DEPTH_ZERO_CONVERGED, depth_zero_add_sample(&zero, samples[4], &surface_pressure));
+    // Mean of 1000.6
+    TEST_CHECK_EQUAL(1001, surface_pressure);
+
+    // Mean of 999.4 below the median, which must round the same way
+    const int32_t low_samples[] = {1000, 999, 999, 1000, 999};
+    zero.count = 0;
+    for (int i = 0; i < 5; i++) {
+        depth_zero_add_sample(&zero, low_samples[i], &surface_pressure);
+    }
+    TEST_CHECK_EQUAL(999, surface_pressure);
+}
+
+int main(void) {
+    TEST_RUN(test_quiet_converges_early);
+    TEST_RUN(test_noisy_converges);
+    TEST_RUN(test_rejects_spikes);
+    TEST_RUN(test_too_noisy_gives_up);
+    TEST_RUN(test_exact_samples);
+    return TEST_RESULT();
+}
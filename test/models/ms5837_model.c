@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "ms5837_model.h"
+
+#define MS5837_ADC_MAX 0xFFFFFF
+
+/**
+ * @brief CRC4 of the PROM, from the datasheet
+ * Calculated with the CRC nibble and word 7 cleared, as the sensor does
+ */
+static uint8_t ms5837_model_crc4(const uint16_t prom[8]) {
+    uint16_t n_prom[8];
+    for (int i = 0; i < 8; i++) {
+        n_prom[i] = prom[i];
+    }
+    n_prom[0] &= 0x0FFF;
+    n_prom[7] = 0;
+
+    unsigned int n_rem = 0;
+    for (int cnt = 0; cnt < 16; cnt++) {
+        if (cnt % 2 == 1) n_rem ^= (unsigned short) (n_prom[cnt >> 1] & 0x00FF);
+        else n_rem ^= (unsigned short) (n_prom[cnt >> 1] >> 8);
+
+        for (int n_bit = 8; n_bit > 0; n_bit--) {
+            if (n_rem & 0x8000) n_rem = (n_rem << 1) ^ 0x3000;
+            else n_rem = (n_rem << 1);
+        }
+    }
+    return (n_rem >> 12) & 0xF;
+}
+
+static uint32_t ms5837_model_clamp_adc(double value) {
+    if (value < 0) {
+        return 0;
+    } else if (value > MS5837_ADC_MAX) {
+        return MS5837_ADC_MAX;
+    }
+    return (uint32_t) llround(value);
+}
+
+void ms5837_model_init(struct ms5837_model *model, uint32_t seed) {
+    // Typical coefficients for the 30BA, with the product id in word 0
+    const uint16_t prom[8] = {0x0340, 34982, 36352, 20328, 22354, 26646, 26146, 0};
+    for (int i = 0; i < 8; i++) {
+        model->prom[i] = prom[i];
+    }
+    model->prom[0] |= ms5837_model_crc4(model->prom) << 12;
+
+    model->pressure_mbar = 1013.25;
+    model->temperature_c = 20;
+    model->pressure_noise_mbar = 0;
+    model->rng_state = (seed ? seed : 1);
+}
+
+uint32_t ms5837_model_convert_d2(struct ms5837_model *model) {
+    // TEMP = 2000 + dT * C6 / 2^23, with TEMP in hundredths of deg C
+    double dT = (model->temperature_c * 100 - 2000) * 8388608.0 / model->prom[6];
+    return ms5837_model_clamp_adc(dT + model->prom[5] * 256.0);
+}
+
+uint32_t ms5837_model_convert_d1(struct ms5837_model *model) {
+    // The firmware compensates with the integer D2, so D1 is generated from the same value
+    double dT = (double) ms5837_model_convert_d2(model) - model->prom[5] * 256.0;
+    double temp = 2000 + dT * model->prom[6] / 8388608.0;
+    double sens = model->prom[1] * 32768.0 + model->prom[3] * dT / 256.0;
+    double off = model->prom[2] * 65536.0 + model->prom[4] * dT / 128.0;
+
+    double off_i;
+    double sens_i;
+    if (temp < 2000) {
+        off_i = 3 * (temp - 2000) * (temp - 2000) / 2;
+        sens_i = 5 * (temp - 2000) * (temp - 2000) / 8;
+        if (temp < -1500) {
+            off_i += 7 * (temp + 1500) * (temp + 1500);
+            sens_i += 4 * (temp + 1500) * (temp + 1500);
+        }
+    } else {
+        off_i = (temp - 2000) * (temp - 2000) / 16;
+        sens_i = 0;
+    }
+
+    // P = (D1 * SENS2 / 2^21 - OFF2) / 2^13, with P in tenths of mbar
+    double pressure_mbar = model->pressure_mbar + model->pressure_noise_mbar * ms5837_model_gaussian(&model->rng_state);
+    double d1 = (pressure_mbar * 10 * 8192.0 + (off - off_i)) * 2097152.0 / (sens - sens_i);
+    return ms5837_model_clamp_adc(d1);
+}
+
+double ms5837_model_gaussian(uint32_t *rng_state) {
+    // xorshift32 into Box-Muller, which is plenty for test noise
+    double u[2];
+    for (int i = 0; i < 2; i++) {
+        uint32_t x = *rng_state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *rng_state = x;
+        u[i] = (x + 1.0) / 4294967297.0;
+    }
+    return sqrt(-2 * log(u[0])) * cos(2 * M_PI * u[1]);
+}
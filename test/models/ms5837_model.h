@@ -0,0 +1,52 @@
+#ifndef _MS5837_MODEL_H
+#define _MS5837_MODEL_H
+
+#include <stdint.h>
+
+/**
+ * @brief Behavioural model of the MS5837-30BA ADC conversions
+ * The conversions are generated by inverting the datasheet compensation in double precision, independently of the firmware
+ */
+struct ms5837_model {
+    // The PROM reported by the sensor, including the CRC4 in the top bits of word 0
+    uint16_t prom[8];
+    double pressure_mbar;
+    double temperature_c;
+    // Standard deviation of the gaussian noise added to each D1 conversion, in mbar
+    double pressure_noise_mbar;
+    uint32_t rng_state;
+};
+
+/**
+ * @brief Initializes the model with a typical PROM, at 1013.25 mbar and 20 deg C with no noise
+ *
+ * @param model The model to initialize
+ * @param seed Seed for the noise, so runs are repeatable
+ */
+void ms5837_model_init(struct ms5837_model *model, uint32_t seed);
+
+/**
+ * @brief Returns the D2 (temperature) conversion for the current temperature
+ *
+ * @param model The model
+ * @return uint32_t The 24-bit D2 conversion
+ */
+uint32_t ms5837_model_convert_d2(struct ms5837_model *model);
+
+/**
+ * @brief Returns the D1 (pressure) conversion for the current pressure and temperature, including noise
+ *
+ * @param model The model
+ * @return uint32_t The 24-bit D1 conversion
+ */
+uint32_t ms5837_model_convert_d1(struct ms5837_model *model);
+
+/**
+ * @brief Returns a normally distributed value with zero mean and unit variance
+ *
+ * @param rng_state State of the generator, updated by the call
+ * @return double The random value
+ */
+double ms5837_model_gaussian(uint32_t *rng_state);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _TEST_COMMON_H
+#define _TEST_COMMON_H
+
+#include <stdio.h>
+
+// Minimal checks for the host tests. Each test executable returns non-zero if any check failed
+
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_CHECK_EQUAL(expected, actual) do { \
+        long long _expected = (long long) (expected); \
+        long long _actual = (long long) (actual); \
+        if (_expected != _actual) { \
+            printf("%s:%d: %s: expected %lld, got %lld\n", __FILE__, __LINE__, #actual, _expected, _actual); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RUN(test_fn) do { \
+        int _failures_before = test_failures; \
+        test_fn(); \
+        printf("%s %s\n", (test_failures == _failures_before ? "PASS" : "FAIL"), #test_fn); \
+    } while (0)
+
+#define TEST_RESULT() (test_failures ? 1 : 0)
+
+#endif